@@ -0,0 +1,217 @@
+#include <algorithm>
+#include <condition_variable>
+#include <cstdio>
+#include <filesystem>
+#include <iostream>
+#include <mutex>
+#include <unordered_map>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "batch.h"
+#include "netlist.h"
+#include "netlist_index.h"
+#include "report.h"
+#include "thread_pool.h"
+
+using obwody::Batch_options;
+using obwody::Buffered_writer;
+using obwody::Error_log;
+using obwody::Netlist;
+using obwody::Netlist_index;
+
+namespace
+{
+    struct File_report
+    {
+        bool finished{ false };
+        bool read{ false };
+        bool written{ false };
+        std::string output;
+        std::string errors;
+    };
+
+    // Reads the whole file. Returns false if it can not be read.
+    bool read_file(std::string const& path, std::string& text)
+    {
+        int fd = open(path.c_str(), O_RDONLY);
+        if(fd < 0)
+            return false;
+
+        constexpr std::size_t block_size{ 1 << 16 };
+        ssize_t count{ 0 };
+        do
+        {
+            auto used = text.size();
+            text.resize(used + block_size);
+            count = read(fd, &text[used], block_size);
+            text.resize(used + std::max<ssize_t>(count, 0));
+        } while(count > 0);
+        close(fd);
+        return count == 0;
+    }
+
+    // Does what obwody does for a single file, keeping the output in the
+    // report.
+    void process_file(std::string const& path, bool report_floating,
+                      File_report& report)
+    {
+        std::string text;
+        report.read = read_file(path, text);
+        if(!report.read)
+            return;
+
+        Error_log error_log;
+        error_log.print = false;
+        error_log.keep = true;
+        auto netlist = obwody::parse_text(text, error_log);
+        Netlist_index index{ netlist, error_log };
+        netlist = Netlist{};
+
+        Buffered_writer output{ report.output };
+        Buffered_writer errors{ report.errors };
+        obwody::print_report(index.image(), true, report_floating,
+                             output, errors);
+    }
+
+    // Name of the report of the file in the output directory: the report of
+    // dir/name.in goes to name.out and name.err.
+    std::string report_name(std::string const& path)
+    {
+        std::filesystem::path name{ path };
+        name = name.extension() == ".in" ? name.stem() : name.filename();
+        return name.string();
+    }
+
+    // Writes the report next to the others in the output directory. Every
+    // file is written through a temporary one, see write_image_file().
+    bool write_report(std::string const& path, std::string const& output_dir,
+                      File_report const& report)
+    {
+        std::filesystem::path base{ output_dir };
+        base /= report_name(path);
+        return obwody::write_image_file(base.string() + ".out",
+                                        report.output.data(),
+                                        report.output.size())
+            && obwody::write_image_file(base.string() + ".err",
+                                        report.errors.data(),
+                                        report.errors.size());
+    }
+}
+
+std::vector<std::string> obwody::expand_batch_paths(
+    std::vector<std::string> const& paths)
+{
+    std::vector<std::string> result;
+    for(auto const& path : paths)
+    {
+        std::error_code error;
+        if(!std::filesystem::is_directory(path, error))
+        {
+            result.push_back(path);
+            continue;
+        }
+
+        std::vector<std::string> files;
+        for(auto const& entry
+            : std::filesystem::directory_iterator{ path, error })
+        {
+            if(entry.is_regular_file(error)
+               && entry.path().extension() == ".in")
+            {
+                files.push_back(entry.path().string());
+            }
+        }
+        std::sort(files.begin(), files.end());
+        result.insert(result.end(), files.begin(), files.end());
+    }
+    return result;
+}
+
+bool obwody::run_batch(std::vector<std::string> const& paths,
+                       Batch_options const& options)
+{
+    // Files of the same name in different directories would overwrite each
+    // other's reports, so nothing is processed then.
+    if(!options.output_dir.empty())
+    {
+        std::unordered_map<std::string, std::string const*> path_of_name;
+        bool unique{ true };
+        for(auto const& path : paths)
+        {
+            auto inserted = path_of_name.emplace(report_name(path), &path);
+            if(!inserted.second)
+            {
+                std::cerr << "Same report name of "
+                          << *inserted.first->second << " and " << path
+                          << '\n';
+                unique = false;
+            }
+        }
+        if(!unique)
+            return false;
+    }
+
+    std::vector<File_report> reports(paths.size());
+    std::mutex mutex;
+    std::condition_variable finished;
+
+    Thread_pool pool{ options.thread_count };
+    for(std::size_t i = 0; i < paths.size(); ++i)
+    {
+        pool.submit([&, i] {
+            auto& report = reports[i];
+            process_file(paths[i], options.report_floating, report);
+            if(report.read && !options.output_dir.empty())
+            {
+                report.written = write_report(paths[i], options.output_dir,
+                                              report);
+                report.output = std::string{};
+                report.errors = std::string{};
+            }
+
+            std::lock_guard<std::mutex> lock{ mutex };
+            report.finished = true;
+            finished.notify_all();
+        });
+    }
+
+    // Reports are printed in the order of the files, as soon as the next
+    // one is ready.
+    bool success{ true };
+    Buffered_writer output{ stdout };
+    for(std::size_t i = 0; i < paths.size(); ++i)
+    {
+        auto& report = reports[i];
+        {
+            std::unique_lock<std::mutex> lock{ mutex };
+            finished.wait(lock, [&] { return report.finished; });
+        }
+
+        if(!report.read || (!options.output_dir.empty() && !report.written))
+        {
+            output.flush();
+            std::fflush(stdout);
+            std::cerr << (report.read ? "Could not write the report of "
+                                      : "Could not read ")
+                      << paths[i] << '\n';
+            success = false;
+            continue;
+        }
+        if(!options.output_dir.empty())
+            continue;
+
+        output.write("==> ");
+        output.write(paths[i]);
+        output.write(" <==\n");
+        output.write(report.output);
+        output.write("==> ");
+        output.write(paths[i]);
+        output.write(" (stderr) <==\n");
+        output.write(report.errors);
+        report.output = std::string{};
+        report.errors = std::string{};
+    }
+    return success;
+}
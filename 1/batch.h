@@ -0,0 +1,43 @@
+#ifndef BATCH_H
+#define BATCH_H
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+// Processing of many netlist files in one process.
+namespace obwody
+{
+    struct Batch_options
+    {
+        // Number of threads, each of them processes one file at a time.
+        std::size_t thread_count{ 1 };
+        bool report_floating{ false };
+
+        // If set, the report of the file dir/name.in (or dir/name) is written
+        // to output_dir/name.out and output_dir/name.err, so the names of
+        // the files must be different. Otherwise all the reports go to the
+        // stdout, see run_batch().
+        std::string output_dir;
+    };
+
+    // Expands the directories among the paths into the *.in files inside,
+    // in the name order.
+    std::vector<std::string> expand_batch_paths(
+        std::vector<std::string> const& paths);
+
+    // Processes the files on the thread pool. Without the output directory,
+    // the reports are printed to the stdout in the order of the files, each
+    // of them as:
+    //     ==> path <==
+    //     what obwody would print to the stdout
+    //     ==> path (stderr) <==
+    //     what obwody would print to the stderr
+    // Returns false if any file could not be read or written, or if two
+    // files would have their reports written to the same output files, in
+    // which case none of them is processed.
+    bool run_batch(std::vector<std::string> const& paths,
+                   Batch_options const& options);
+}
+
+#endif
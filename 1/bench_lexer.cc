@@ -0,0 +1,193 @@
+// Throughput benchmark of the hand written lexer against the regex the first
+// version of the program used. Before measuring, both parsers are run on every
+// benchmark line and the results are compared, so the benchmark also checks
+// that the lexer accepts exactly the same lines as the regex, both with and
+// without the masks of the scan kernels.
+//
+// Usage: ./bench_lexer [netlist file] [number of lines]
+// Lines of the netlist file (_schemat.in by default) are repeated and randomly
+// mutated until the requested number of lines (20000 by default) is reached.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <regex>
+#include <string>
+#include <vector>
+
+#include "lexer.h"
+#include "reference.h"
+#include "scan.h"
+
+using reference::correct_line_regexp;
+using reference::regex_parse_line;
+
+namespace
+{
+    // Characters used when mutating lines, chosen so that mutations often
+    // land on the edge of the grammar.
+    constexpr char mutation_chars[]{ " \t0019aZ,-/TDRCEx" };
+
+    std::vector<std::string> make_lines(std::vector<std::string> const& base,
+                                        std::size_t count)
+    {
+        std::mt19937 rng{ 42 };
+        std::vector<std::string> lines;
+        lines.reserve(count);
+        for(std::size_t i = 0; i < count; ++i)
+        {
+            auto line = base[i % base.size()];
+
+            // Every fourth line gets a random character replaced or inserted.
+            if(rng() % 4 == 0)
+            {
+                char c = mutation_chars[rng() % (sizeof(mutation_chars) - 1)];
+                auto pos = line.empty() ? 0 : rng() % line.size();
+                if(rng() % 2 == 0 && !line.empty())
+                    line[pos] = c;
+                else
+                    line.insert(line.begin() + pos, c);
+            }
+            lines.push_back(std::move(line));
+        }
+        return lines;
+    }
+
+    template<typename F>
+    double measure_seconds(F f)
+    {
+        auto start = std::chrono::steady_clock::now();
+        f();
+        std::chrono::duration<double> elapsed{
+            std::chrono::steady_clock::now() - start };
+        return elapsed.count();
+    }
+}
+
+int main(int argc, char** argv)
+{
+    std::string path{ argc > 1 ? argv[1] : "_schemat.in" };
+    std::size_t count = argc > 2 ? std::strtoull(argv[2], nullptr, 10)
+                                 : 20000;
+
+    std::ifstream input{ path };
+    std::vector<std::string> base;
+    for(std::string line; std::getline(input, line); )
+        base.push_back(line);
+    if(base.empty())
+    {
+        std::cerr << "Could not read any lines from " << path << '\n';
+        return 1;
+    }
+
+    auto lines = make_lines(base, count);
+    std::size_t bytes{ 0 };
+    for(auto const& line : lines)
+        bytes += line.size() + 1;
+
+    // Masks of the lines, as the scanner computes them for the whole text.
+    std::string text;
+    for(auto const& line : lines)
+        text += line + '\n';
+    std::vector<scan::Masks> masks;
+    std::vector<bool> has_masks;
+    {
+        scan::Line_scanner scanner{ text.data(), text.data() + text.size() };
+        std::string_view line;
+        scan::Masks const* line_masks;
+        while(scanner.next(line, line_masks))
+        {
+            has_masks.push_back(line_masks != nullptr);
+            masks.push_back(line_masks != nullptr ? *line_masks
+                                                  : scan::Masks{});
+        }
+    }
+
+    // Check that both parsers agree on every line, and that the lexer gives
+    // the same results with the masks.
+    std::regex const compiled_regex{ correct_line_regexp };
+    std::size_t mismatches{ 0 };
+    std::size_t accepted{ 0 };
+    for(std::size_t i = 0; i < lines.size(); ++i)
+    {
+        auto const& line = lines[i];
+        std::string id, name;
+        std::vector<int> values;
+        lexer::Parsed_line parsed;
+        bool regex_result = regex_parse_line(line, compiled_regex,
+                                             id, name, values);
+        bool lexer_result = lexer::parse_line(line, parsed);
+
+        bool same = regex_result == lexer_result;
+        if(same && regex_result)
+        {
+            same = id == parsed.id && name == parsed.name
+                && values.size() == static_cast<std::size_t>(parsed.node_count)
+                && std::equal(values.begin(), values.end(), parsed.nodes);
+        }
+
+        if(has_masks[i])
+        {
+            lexer::Parsed_line masked;
+            bool masks_result = lexer::parse_line(
+                line, lexer::Mask_classes{ masks[i] }, masked);
+            same = same && masks_result == lexer_result;
+            if(same && masks_result)
+            {
+                same = masked.id == parsed.id && masked.name == parsed.name
+                    && masked.node_count == parsed.node_count
+                    && std::equal(parsed.nodes,
+                                  parsed.nodes + parsed.node_count,
+                                  masked.nodes);
+            }
+        }
+
+        if(!same)
+        {
+            if(mismatches++ < 10)
+                std::cerr << "Mismatch: \"" << line << "\"\n";
+        }
+        accepted += regex_result;
+    }
+
+    std::size_t sink{ 0 };
+    auto regex_time = measure_seconds([&] {
+        std::string id, name;
+        std::vector<int> values;
+        for(auto const& line : lines)
+        {
+            std::regex reg_expression{ correct_line_regexp };
+            sink += regex_parse_line(line, reg_expression, id, name, values);
+        }
+    });
+    auto compiled_regex_time = measure_seconds([&] {
+        std::string id, name;
+        std::vector<int> values;
+        for(auto const& line : lines)
+            sink += regex_parse_line(line, compiled_regex, id, name, values);
+    });
+    auto lexer_time = measure_seconds([&] {
+        lexer::Parsed_line parsed;
+        for(auto const& line : lines)
+            sink += lexer::parse_line(line, parsed);
+    });
+
+    auto megabytes = bytes / 1e6;
+    std::cout << lines.size() << " lines, " << accepted << " correct, "
+              << mismatches << " mismatches\n"
+              << "regex: " << regex_time << " s, "
+              << megabytes / regex_time << " MB/s\n"
+              << "compiled regex: " << compiled_regex_time << " s, "
+              << megabytes / compiled_regex_time << " MB/s\n"
+              << "lexer: " << lexer_time << " s, "
+              << megabytes / lexer_time << " MB/s\n"
+              << "speedup: " << regex_time / lexer_time << "x\n";
+
+    // Keep the compiler from throwing away the measured loops.
+    if(sink != 3 * accepted)
+        return 1;
+    return mismatches == 0 ? 0 : 1;
+}
@@ -0,0 +1,238 @@
+// End-to-end benchmark of obwody on a generated netlist (see generator.h).
+// It measures the throughput of every stage: lexing alone, the sequential
+// and the parallel parser, building the index and printing the report, and
+// prints the phases of the parallel run as obwody --stats does.
+//
+// The results are checked: the reports of the sequential and the parallel
+// parser of the large netlist must be the same, and the reports of a
+// smaller netlist, generated with the same options, must be the same as
+// the report of the reference implementation (see reference.h), which is
+// too slow to run on the large one.
+//
+// Usage: ./bench_obwody [lines] [threads] [reference lines]
+// The defaults are 1000000 lines, 4 threads and 100000 reference lines.
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "generator.h"
+#include "netlist.h"
+#include "netlist_index.h"
+#include "reference.h"
+#include "report.h"
+#include "stats.h"
+
+using obwody::Buffered_writer;
+using obwody::Error_log;
+using obwody::Netlist;
+using obwody::Netlist_index;
+using obwody::Stats;
+
+namespace
+{
+    template<typename F>
+    double measure_seconds(F f)
+    {
+        auto start = std::chrono::steady_clock::now();
+        f();
+        std::chrono::duration<double> elapsed{
+            std::chrono::steady_clock::now() - start };
+        return elapsed.count();
+    }
+
+    void print_speed(char const* stage, double seconds, std::size_t bytes,
+                     std::size_t lines)
+    {
+        std::cout << "    " << stage << ": " << seconds << " s, "
+                  << bytes / seconds / 1e6 << " MB/s, "
+                  << lines / seconds / 1e6 << " M lines/s\n";
+    }
+
+    std::string generate(obwody::Generator_options const& options)
+    {
+        std::string text;
+        Buffered_writer output{ text };
+        obwody::generate_netlist(options, output);
+        output.flush();
+        return text;
+    }
+
+    // The text is parsed from a temporary file, as the parallel parser reads
+    // the file descriptor.
+    class Temporary_file
+    {
+    public:
+        explicit Temporary_file(std::string const& text)
+        {
+            char path_template[]{ "/tmp/bench_obwodyXXXXXX" };
+            fd = mkstemp(path_template);
+            if(fd < 0)
+                return;
+            path = path_template;
+            for(std::size_t written = 0; written < text.size(); )
+            {
+                auto count = write(fd, text.data() + written,
+                                   text.size() - written);
+                if(count <= 0)
+                    break;
+                written += count;
+            }
+        }
+
+        ~Temporary_file()
+        {
+            if(fd >= 0)
+            {
+                close(fd);
+                unlink(path.c_str());
+            }
+        }
+
+        Temporary_file(Temporary_file const&) = delete;
+        Temporary_file& operator=(Temporary_file const&) = delete;
+
+        // Opens the file again, from the beginning.
+        int open_file() const
+        {
+            return fd < 0 ? -1 : ::open(path.c_str(), O_RDONLY);
+        }
+
+    private:
+        int fd{ -1 };
+        std::string path;
+    };
+
+    // The report as obwody prints it for the parsed netlist, with --floating.
+    reference::Report make_report(Netlist& netlist, Error_log const& errors,
+                                  Stats* stats = nullptr)
+    {
+        Netlist_index index{ netlist, errors, obwody::Source_stamp{}, stats };
+        reference::Report report;
+        {
+            Buffered_writer output{ report.output };
+            Buffered_writer error_output{ report.errors };
+            obwody::print_report(index.image(), true, true, output,
+                                 error_output);
+        }
+        return report;
+    }
+
+    Error_log quiet_log()
+    {
+        Error_log log;
+        log.print = false;
+        log.keep = true;
+        return log;
+    }
+
+    Netlist parse_file(Temporary_file const& file, std::size_t threads,
+                       Error_log& log, Stats* stats = nullptr)
+    {
+        int fd = file.open_file();
+        auto netlist = obwody::parse_parallel(fd, threads, log, stats);
+        close(fd);
+        return netlist;
+    }
+
+    bool same_report(char const* what, reference::Report const& expected,
+                     reference::Report const& result)
+    {
+        bool same = expected.output == result.output
+            && expected.errors == result.errors;
+        std::cout << "    " << what << (same ? ": same\n" : ": DIFFERENT\n");
+        return same;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    obwody::Generator_options options;
+    options.line_count = argc > 1 ? std::strtoull(argv[1], nullptr, 10)
+                                  : 1000000;
+    std::size_t threads = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 4;
+    std::size_t reference_lines = argc > 3
+        ? std::strtoull(argv[3], nullptr, 10)
+        : 100000;
+    if(threads == 0)
+        threads = 1;
+
+    std::string text;
+    auto generate_time = measure_seconds([&] { text = generate(options); });
+    auto bytes = text.size();
+    auto lines = options.line_count;
+    std::cout << lines << " lines, " << bytes << " bytes\n";
+    print_speed("generate", generate_time, bytes, lines);
+
+    std::size_t correct{ 0 };
+    auto lex_time = measure_seconds([&] {
+        scan::Line_scanner scanner{ text.data(), text.data() + text.size() };
+        std::string_view line;
+        scan::Masks const* masks;
+        lexer::Parsed_line parsed;
+        while(scanner.next(line, masks))
+            correct += lexer::parse_line(line, masks, parsed);
+    });
+    print_speed("scan and lex", lex_time, bytes, lines);
+    std::cout << "    " << correct << " lines lexed correctly\n";
+
+    auto sequential_log = quiet_log();
+    Netlist sequential;
+    auto sequential_time = measure_seconds([&] {
+        sequential = obwody::parse_text(text, sequential_log);
+    });
+    print_speed("parse, sequential", sequential_time, bytes, lines);
+
+    Temporary_file file{ text };
+    auto parallel_log = quiet_log();
+    Netlist parallel;
+    Stats stats;
+    auto parallel_start = std::chrono::steady_clock::now();
+    auto parallel_time = measure_seconds([&] {
+        parallel = parse_file(file, threads, parallel_log, &stats);
+    });
+    print_speed("parse, parallel", parallel_time, bytes, lines);
+
+    reference::Report parallel_report;
+    auto report_time = measure_seconds([&] {
+        parallel_report = make_report(parallel, parallel_log, &stats);
+    });
+    print_speed("index and print", report_time, bytes, lines);
+    print_speed("end to end, parallel", parallel_time + report_time, bytes,
+                lines);
+
+    stats.error_count = parallel_log.count;
+    stats.record_netlist(parallel);
+    stats.report(std::cout, parallel_start);
+
+    std::cout << "checks:\n";
+    bool same = same_report("sequential and parallel",
+                            make_report(sequential, sequential_log),
+                            parallel_report);
+    sequential = Netlist{};
+    parallel = Netlist{};
+
+    options.line_count = reference_lines;
+    auto reference_text = generate(options);
+    auto expected = reference::make_report(reference_text, true);
+
+    auto reference_log = quiet_log();
+    auto reference_netlist = obwody::parse_text(reference_text, reference_log);
+    same = same_report("sequential and reference", expected,
+                       make_report(reference_netlist, reference_log))
+        && same;
+
+    Temporary_file reference_file{ reference_text };
+    reference_log = quiet_log();
+    reference_netlist = parse_file(reference_file, threads, reference_log);
+    same = same_report("parallel and reference", expected,
+                       make_report(reference_netlist, reference_log))
+        && same;
+
+    return same ? 0 : 1;
+}
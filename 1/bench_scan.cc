@@ -0,0 +1,162 @@
+// Throughput benchmark of the scan kernels. The netlist file is repeated until
+// the requested size is reached, and then, for every kernel the CPU supports,
+// the benchmark measures finding the newlines, classifying the text, splitting
+// it into lines and lexing them. The baseline splits the lines with memchr and
+// lexes them character by character. Results of all kernels are compared with
+// the baseline.
+//
+// Usage: ./bench_scan [netlist file] [size in MB]
+// The defaults are _schemat.in and 64 MB.
+
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "lexer.h"
+#include "scan.h"
+
+namespace
+{
+    template<typename F>
+    double measure_seconds(F f)
+    {
+        auto start = std::chrono::steady_clock::now();
+        f();
+        std::chrono::duration<double> elapsed{
+            std::chrono::steady_clock::now() - start };
+        return elapsed.count();
+    }
+
+    // What the lexing of the whole text found, to compare the kernels.
+    struct Result
+    {
+        std::size_t lines{ 0 };
+        std::size_t correct{ 0 };
+        std::uint64_t checksum{ 0 };
+
+        void add(bool correct_line, lexer::Parsed_line const& parsed)
+        {
+            ++lines;
+            if(!correct_line)
+                return;
+            ++correct;
+            checksum = checksum * 31 + parsed.number;
+            for(int i = 0; i < parsed.node_count; ++i)
+                checksum = checksum * 31 + parsed.nodes[i];
+        }
+
+        bool operator==(Result const& other) const
+        {
+            return lines == other.lines && correct == other.correct
+                && checksum == other.checksum;
+        }
+    };
+
+    void print_speed(char const* what, std::size_t bytes, double seconds)
+    {
+        std::cout << "    " << what << ": " << bytes / seconds / 1e9
+                  << " GB/s\n";
+    }
+}
+
+int main(int argc, char** argv)
+{
+    std::string path{ argc > 1 ? argv[1] : "_schemat.in" };
+    std::size_t megabytes = argc > 2 ? std::strtoull(argv[2], nullptr, 10)
+                                     : 64;
+
+    std::ifstream input{ path };
+    std::string base{ std::istreambuf_iterator<char>{ input },
+                      std::istreambuf_iterator<char>{} };
+    if(base.empty())
+    {
+        std::cerr << "Could not read " << path << '\n';
+        return 1;
+    }
+    if(base.back() != '\n')
+        base += '\n';
+
+    std::string text;
+    text.reserve(megabytes << 20);
+    while(text.size() + base.size() <= megabytes << 20)
+        text += base;
+    auto const* begin = text.data();
+    auto const* end = begin + text.size();
+
+    Result expected;
+    auto baseline_time = measure_seconds([&] {
+        lexer::Parsed_line parsed;
+        for(auto const* line = begin; line < end; )
+        {
+            auto const* newline = static_cast<char const*>(
+                std::memchr(line, '\n', end - line));
+            std::string_view view{ line, std::size_t(newline - line) };
+            expected.add(lexer::parse_line(view, parsed), parsed);
+            line = newline + 1;
+        }
+    });
+    std::cout << text.size() << " bytes, " << expected.lines << " lines\n"
+              << "memchr and character by character lexer:\n";
+    print_speed("split and lex", text.size(), baseline_time);
+
+    std::vector<scan::Masks> masks((text.size() + scan::mask_bits - 1)
+                                   / scan::mask_bits);
+    bool same{ true };
+    for(auto kernel : { scan::Kernel::scalar, scan::Kernel::sse42,
+                        scan::Kernel::avx2 })
+    {
+        if(!scan::set_kernel(kernel))
+        {
+            std::cout << scan::kernel_name(kernel) << ": not supported\n";
+            continue;
+        }
+
+        std::size_t newline_count{ 0 };
+        auto newline_time = measure_seconds([&] {
+            for(auto const* line = begin; line < end; ++newline_count)
+                line = scan::find_newline(line, end) + 1;
+        });
+        auto classify_time = measure_seconds([&] {
+            scan::classify(begin, text.size(), masks.data());
+        });
+
+        std::size_t scanned_lines{ 0 };
+        auto split_time = measure_seconds([&] {
+            scan::Line_scanner scanner{ begin, end };
+            std::string_view line;
+            scan::Masks const* line_masks;
+            while(scanner.next(line, line_masks))
+                ++scanned_lines;
+        });
+
+        Result result;
+        auto lex_time = measure_seconds([&] {
+            scan::Line_scanner scanner{ begin, end };
+            std::string_view line;
+            scan::Masks const* line_masks;
+            lexer::Parsed_line parsed;
+            while(scanner.next(line, line_masks))
+                result.add(lexer::parse_line(line, line_masks, parsed), parsed);
+        });
+
+        bool kernel_same = result == expected
+            && newline_count == expected.lines
+            && scanned_lines == expected.lines;
+        same = same && kernel_same;
+
+        std::cout << scan::kernel_name(kernel)
+                  << (kernel_same ? ":\n" : ": results differ\n");
+        print_speed("find newlines", text.size(), newline_time);
+        print_speed("classify", text.size(), classify_time);
+        print_speed("split", text.size(), split_time);
+        print_speed("split and lex", text.size(), lex_time);
+    }
+    return same ? 0 : 1;
+}
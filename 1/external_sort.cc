@@ -0,0 +1,43 @@
+#include <cstdlib>
+
+#include <unistd.h>
+
+#include "external_sort.h"
+
+using obwody::Spill_file;
+
+Spill_file::Spill_file(std::string const& directory)
+{
+    std::string path{ directory + "/obwody_spillXXXXXX" };
+    int fd = mkstemp(path.data());
+    if(fd >= 0)
+    {
+        unlink(path.c_str());
+        file = fdopen(fd, "w+b");
+        if(file == nullptr)
+            close(fd);
+    }
+
+    if(file == nullptr)
+    {
+        failed = true;
+        return;
+    }
+    buffer.reset(new char[buffer_size]);
+    std::setvbuf(file, buffer.get(), _IOFBF, buffer_size);
+}
+
+Spill_file::~Spill_file()
+{
+    if(file != nullptr)
+        std::fclose(file);
+}
+
+void Spill_file::rewind()
+{
+    if(file == nullptr)
+        return;
+    if(std::fflush(file) != 0 || std::ferror(file))
+        failed = true;
+    std::fseek(file, 0, SEEK_SET);
+}
@@ -0,0 +1,207 @@
+#ifndef EXTERNAL_SORT_H
+#define EXTERNAL_SORT_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdio>
+#include <functional>
+#include <memory>
+#include <queue>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Sorting of more records than fit in the memory: they are collected in a
+// buffer, which is sorted and written to a temporary file (a run) whenever it
+// grows over the budget, and the runs are merged at the end.
+namespace obwody
+{
+    // Temporary file, removed from the directory as soon as it is created, so
+    // that nothing is left behind even if the program is killed. It is
+    // written first and then read from the beginning.
+    class Spill_file
+    {
+    public:
+        explicit Spill_file(std::string const& directory);
+        ~Spill_file();
+
+        Spill_file(Spill_file const&) = delete;
+        Spill_file& operator=(Spill_file const&) = delete;
+
+        void write(void const* data, std::size_t size)
+        {
+            if(file != nullptr
+               && std::fwrite(data, 1, size, file) != size)
+                failed = true;
+        }
+
+        // Returns false at the end of the file.
+        bool read(void* data, std::size_t size)
+        {
+            return file != nullptr && std::fread(data, 1, size, file) == size;
+        }
+
+        // Ends the writing, the next read starts at the beginning.
+        void rewind();
+
+        // Set if the file could not be created or written.
+        bool failed{ false };
+
+    private:
+        static constexpr std::size_t buffer_size{ 1 << 16 };
+
+        std::FILE* file{ nullptr };
+        std::unique_ptr<char[]> buffer;
+    };
+
+    // Sorts the records with the [Less] order, which must be total. Records
+    // provide:
+    //     std::size_t memory_size() const    bytes they take in the buffer,
+    //     void write(Spill_file&) const,
+    //     bool read(Spill_file&)             false at the end of the file.
+    // Runs are merged [fan_in] at a time, as soon as there are that many of
+    // the same size, so the records are written O(log(size / budget)) times
+    // and only a few files are open at once.
+    template<typename Record, typename Less = std::less<Record>>
+    class External_sorter
+    {
+    public:
+        External_sorter(std::size_t memory_budget_, std::string directory_,
+                        Less less_ = Less{})
+            : memory_budget{ memory_budget_ },
+              directory{ std::move(directory_) },
+              less{ less_ }
+        {
+        }
+
+        void push(Record record)
+        {
+            buffered_size += record.memory_size();
+            buffer.push_back(std::move(record));
+            if(buffered_size > memory_budget)
+                spill();
+        }
+
+        // Calls f(record) for all the records in order, and empties the
+        // sorter. If nothing was spilled, the records are just sorted in
+        // the memory.
+        template<typename F>
+        void merge(F f)
+        {
+            if(runs.empty())
+            {
+                std::sort(buffer.begin(), buffer.end(), less);
+                for(auto& record : buffer)
+                    f(record);
+            }
+            else
+            {
+                spill();
+                buffer = std::vector<Record>{};
+                std::vector<Spill_file*> files;
+                for(auto& run : runs)
+                    files.push_back(run.file.get());
+                merge_files(files, f);
+            }
+            buffer = std::vector<Record>{};
+            buffered_size = 0;
+            runs.clear();
+        }
+
+        // Number of the runs written, counting the merged ones.
+        std::size_t spilled_run_count() const
+        {
+            return spilled_runs;
+        }
+
+        // Set if any of the runs could not be written.
+        bool failed() const
+        {
+            return write_failed;
+        }
+
+    private:
+        static constexpr std::size_t fan_in{ 64 };
+
+        struct Run
+        {
+            std::unique_ptr<Spill_file> file;
+            int level;
+        };
+
+        void spill()
+        {
+            std::sort(buffer.begin(), buffer.end(), less);
+            auto file = std::make_unique<Spill_file>(directory);
+            for(auto const& record : buffer)
+                record.write(*file);
+            buffer.clear();
+            buffered_size = 0;
+            add_run(std::move(file), 0);
+
+            // Merges the last runs while there are [fan_in] of them of the
+            // same level. Levels never grow towards the end of [runs].
+            while(runs.size() >= fan_in
+                  && runs[runs.size() - fan_in].level == runs.back().level)
+            {
+                auto first = runs.end() - fan_in;
+                std::vector<Spill_file*> files;
+                for(auto run = first; run != runs.end(); ++run)
+                    files.push_back(run->file.get());
+
+                auto merged = std::make_unique<Spill_file>(directory);
+                merge_files(files, [&](Record const& record) {
+                    record.write(*merged);
+                });
+                int level = runs.back().level + 1;
+                runs.erase(first, runs.end());
+                add_run(std::move(merged), level);
+            }
+        }
+
+        void add_run(std::unique_ptr<Spill_file> file, int level)
+        {
+            file->rewind();
+            write_failed = write_failed || file->failed;
+            ++spilled_runs;
+            runs.push_back(Run{ std::move(file), level });
+        }
+
+        // The k-way merge, with the next record of every file in a heap.
+        template<typename F>
+        void merge_files(std::vector<Spill_file*> const& files, F f)
+        {
+            std::vector<Record> heads(files.size());
+            auto greater = [&](std::size_t lhs, std::size_t rhs) {
+                return less(heads[rhs], heads[lhs]);
+            };
+            std::priority_queue<std::size_t, std::vector<std::size_t>,
+                                decltype(greater)> queue{ greater };
+            for(std::size_t i = 0; i < files.size(); ++i)
+            {
+                if(heads[i].read(*files[i]))
+                    queue.push(i);
+            }
+
+            while(!queue.empty())
+            {
+                auto i = queue.top();
+                queue.pop();
+                f(heads[i]);
+                if(heads[i].read(*files[i]))
+                    queue.push(i);
+            }
+        }
+
+        std::size_t memory_budget;
+        std::string directory;
+        Less less;
+        std::vector<Record> buffer;
+        std::size_t buffered_size{ 0 };
+        std::vector<Run> runs;
+        std::size_t spilled_runs{ 0 };
+        bool write_failed{ false };
+    };
+}
+
+#endif
@@ -0,0 +1,54 @@
+// Writes a synthetic netlist to the stdout, see generator.h.
+//
+// Usage: ./gen_netlist [lines] [--names N] [--transistors fraction]
+//                      [--errors fraction] [--nodes N] [--seed N]
+
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+#include "generator.h"
+
+int main(int argc, char** argv)
+{
+    obwody::Generator_options options;
+    for(int i = 1; i < argc; ++i)
+    {
+        bool has_value = i + 1 < argc;
+        if(std::strcmp(argv[i], "--names") == 0 && has_value)
+        {
+            options.name_count = std::strtoull(argv[++i], nullptr, 10);
+        }
+        else if(std::strcmp(argv[i], "--transistors") == 0 && has_value)
+        {
+            options.three_terminal_fraction = std::strtod(argv[++i], nullptr);
+        }
+        else if(std::strcmp(argv[i], "--errors") == 0 && has_value)
+        {
+            options.error_rate = std::strtod(argv[++i], nullptr);
+        }
+        else if(std::strcmp(argv[i], "--nodes") == 0 && has_value)
+        {
+            options.node_count = std::strtoull(argv[++i], nullptr, 10);
+        }
+        else if(std::strcmp(argv[i], "--seed") == 0 && has_value)
+        {
+            options.seed = std::strtoull(argv[++i], nullptr, 10);
+        }
+        else if(argv[i][0] != '-')
+        {
+            options.line_count = std::strtoull(argv[i], nullptr, 10);
+        }
+        else
+        {
+            std::cerr << "Usage: " << argv[0]
+                      << " [lines] [--names N] [--transistors fraction]"
+                      << " [--errors fraction] [--nodes N] [--seed N]\n";
+            return 1;
+        }
+    }
+
+    obwody::Buffered_writer output{ stdout };
+    obwody::generate_netlist(options, output);
+    return 0;
+}
@@ -0,0 +1,215 @@
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "generator.h"
+
+using obwody::Buffered_writer;
+using obwody::Generator_options;
+
+namespace
+{
+    // SplitMix64, which gives the same numbers everywhere.
+    class Random
+    {
+    public:
+        explicit Random(std::uint64_t seed) : state{ seed }
+        {
+        }
+
+        std::uint64_t next()
+        {
+            std::uint64_t z = (state += 0x9e3779b97f4a7c15);
+            z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9;
+            z = (z ^ (z >> 27)) * 0x94d049bb133111eb;
+            return z ^ (z >> 31);
+        }
+
+        // Uniform in [0, 1).
+        double uniform()
+        {
+            return (next() >> 11) * 0x1.0p-53;
+        }
+
+        // Uniform in [0, bound), bound must be positive.
+        std::uint64_t below(std::uint64_t bound)
+        {
+            return next() % bound;
+        }
+
+    private:
+        std::uint64_t state;
+    };
+
+    constexpr char two_terminal_types[]{ "DRCE" };
+    constexpr char types[]{ "TDRCE" };
+
+    // Names of the elements look like the real ones: resistors and
+    // capacitors get the values of the E12 and E6 series, transistors and
+    // diodes the part numbers and sources the voltages. Values beyond the
+    // series get the power or voltage rating appended.
+    std::string element_name(char type, std::uint64_t index)
+    {
+        static char const* const e12[]{ "1", "1,2", "1,5", "1,8", "2,2",
+                                        "2,7", "3,3", "3,9", "4,7", "5,6",
+                                        "6,8", "8,2" };
+        static char const* const resistor_units[]{ "", "0", "00", "k", "0k",
+                                                   "00k", "M", "0M", "00M" };
+        static char const* const e6[]{ "1", "1,5", "2,2", "3,3", "4,7",
+                                       "6,8" };
+        static char const* const capacitor_units[]{ "p", "0p", "00p", "n",
+                                                    "0n", "00n", "u", "0u",
+                                                    "00u" };
+        switch(type)
+        {
+            case 'R':
+            {
+                constexpr std::uint64_t values{ 12 * 9 };
+                std::string name{ e12[index % 12] };
+                name += resistor_units[index / 12 % 9];
+                if(index >= values)
+                    name += "/" + std::to_string(index / values) + "W";
+                return name;
+            }
+            case 'C':
+            {
+                constexpr std::uint64_t values{ 6 * 9 };
+                std::string name{ e6[index % 6] };
+                name += capacitor_units[index / 6 % 9];
+                if(index >= values)
+                    name += "/" + std::to_string(index / values) + "V";
+                return name;
+            }
+            case 'T':
+                return "BC" + std::to_string(107 + index);
+            case 'D':
+                return "1N" + std::to_string(4148 + index);
+            default:
+                return std::to_string(index + 1) + "V";
+        }
+    }
+
+    // Element of the netlist, before it is written.
+    struct Line
+    {
+        char type;
+        std::uint64_t number;
+        std::string const* name;
+        std::uint64_t nodes[3];
+        int node_count;
+    };
+
+    void write_line(Buffered_writer& output, Line const& line)
+    {
+        output.write(line.type);
+        output.write_number(line.number);
+        output.write(' ');
+        output.write(*line.name);
+        for(int i = 0; i < line.node_count; ++i)
+        {
+            output.write(' ');
+            output.write_number(line.nodes[i]);
+        }
+        output.write('\n');
+    }
+}
+
+void obwody::generate_netlist(Generator_options const& options,
+                              Buffered_writer& output)
+{
+    Random random{ options.seed };
+    auto name_count = std::max<std::uint64_t>(options.name_count, 1);
+    auto node_count = options.node_count != 0
+        ? options.node_count
+        : std::max<std::uint64_t>(options.line_count / 2, 2);
+
+    // Names of every type, in the order of their popularity.
+    std::vector<std::string> type_names[sizeof(types) - 1];
+    for(std::size_t type = 0; type < sizeof(types) - 1; ++type)
+    {
+        type_names[type].reserve(name_count);
+        for(std::uint64_t i = 0; i < name_count; ++i)
+            type_names[type].push_back(element_name(types[type], i));
+    }
+
+    // Numbers of the elements, counted separately for every type.
+    std::uint64_t numbers[sizeof(types) - 1]{};
+    for(std::uint64_t line_no = 0; line_no < options.line_count; ++line_no)
+    {
+        std::size_t type = random.uniform() < options.three_terminal_fraction
+            ? 0
+            : 1 + random.below(sizeof(two_terminal_types) - 1);
+
+        // The cube makes the first names the most popular ones.
+        auto popularity = random.uniform();
+        auto name_index = static_cast<std::uint64_t>(
+            popularity * popularity * popularity * name_count);
+
+        Line line{ types[type], ++numbers[type],
+                   &type_names[type][name_index], {}, type == 0 ? 3 : 2 };
+
+        // The nodes are around the one matching the position in the file,
+        // and different from each other, as long as there are enough nodes.
+        auto base = line_no * node_count / options.line_count;
+        for(int i = 0; i < line.node_count; ++i)
+        {
+            auto kind = random.uniform();
+            std::uint64_t node;
+            if(kind < 0.1)
+                node = 0;
+            else if(kind < 0.15)
+                node = 1 + random.below(node_count);
+            else
+                node = 1 + (base + random.below(8)) % node_count;
+            for(int tries = 0; tries < line.node_count
+                && std::find(line.nodes, line.nodes + i, node)
+                    != line.nodes + i; ++tries)
+            {
+                node = 1 + node % node_count;
+            }
+            line.nodes[i] = node;
+        }
+
+        if(random.uniform() < options.error_rate)
+        {
+            switch(random.below(5))
+            {
+                case 0:
+                    // Repeated id, unless it is the first of the type.
+                    if(line.number > 1)
+                    {
+                        --numbers[type];
+                        line.number = 1 + random.below(line.number - 1);
+                    }
+                    break;
+                case 1:
+                    // Connected to a single node.
+                    std::fill(line.nodes, line.nodes + line.node_count,
+                              line.nodes[0]);
+                    break;
+                case 2:
+                    // Missing node.
+                    --line.node_count;
+                    break;
+                case 3:
+                    // Name starting with a lowercase letter.
+                    output.write(line.type);
+                    output.write_number(line.number);
+                    output.write(" x");
+                    output.write(*line.name);
+                    output.write(" 1 2 3\n");
+                    continue;
+                default:
+                    // Number with a leading zero.
+                    output.write(line.type);
+                    output.write('0');
+                    output.write_number(line.number);
+                    output.write(' ');
+                    output.write(*line.name);
+                    output.write(" 1 2 3\n");
+                    continue;
+            }
+        }
+        write_line(output, line);
+    }
+}
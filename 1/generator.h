@@ -0,0 +1,43 @@
+#ifndef GENERATOR_H
+#define GENERATOR_H
+
+#include <cstdint>
+
+#include "report.h"
+
+// Generator of synthetic netlists for the benchmarks. The output depends only
+// on the options: the random numbers come from its own generator, not from
+// the standard library distributions, which differ between implementations.
+namespace obwody
+{
+    struct Generator_options
+    {
+        // Number of lines, including the incorrect ones.
+        std::uint64_t line_count{ 1000000 };
+
+        // Number of distinct names of every type. Names are reused the way
+        // they are in real netlists: a few of them (the common resistor
+        // values, the one transistor type) are used by most of the elements.
+        std::uint64_t name_count{ 1000 };
+
+        // Fraction of the elements which are transistors, the rest are the
+        // two-terminal D, R, C and E.
+        double three_terminal_fraction{ 0.25 };
+
+        // Fraction of the lines which are incorrect: repeated ids, elements
+        // connected to a single node and lines breaking the grammar.
+        double error_rate{ 0.01 };
+
+        // Number of nodes other than the ground, 0 means half of the lines.
+        // Elements connect nodes close to each other, with the ground and a
+        // few distant nodes mixed in.
+        std::uint64_t node_count{ 0 };
+
+        std::uint64_t seed{ 1 };
+    };
+
+    void generate_netlist(Generator_options const& options,
+                          Buffered_writer& output);
+}
+
+#endif
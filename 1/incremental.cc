@@ -0,0 +1,467 @@
+#include <algorithm>
+#include <limits>
+#include <tuple>
+
+#include "incremental.h"
+#include "lexer.h"
+
+using obwody::Buffered_writer;
+using obwody::element_priority;
+using obwody::Id;
+using obwody::Incremental_netlist;
+using obwody::Name;
+using obwody::type_count;
+using obwody::types_by_priority;
+
+struct Incremental_netlist::Line
+{
+    std::string text;
+
+    // Links of the treap, which is a heap by [priority] and a search tree
+    // by the position in the text. [size] is the size of the subtree.
+    Line* left{ nullptr };
+    Line* right{ nullptr };
+    Line* parent{ nullptr };
+    std::uint32_t priority;
+    std::size_t size{ 1 };
+
+    // Element of the line, meaningful only if the line is correct.
+    bool correct{ false };
+    bool active{ false };
+    Id id;
+    Name name;
+    int nodes[3];
+    int node_count;
+};
+
+namespace
+{
+    using Line = Incremental_netlist::Line;
+
+    std::size_t size_of(Line const* line)
+    {
+        return line != nullptr ? line->size : 0;
+    }
+
+    void update(Line* line)
+    {
+        line->size = 1 + size_of(line->left) + size_of(line->right);
+        if(line->left != nullptr)
+            line->left->parent = line;
+        if(line->right != nullptr)
+            line->right->parent = line;
+    }
+
+    Line* merge(Line* first, Line* second)
+    {
+        if(first == nullptr)
+            return second;
+        if(second == nullptr)
+            return first;
+
+        if(first->priority > second->priority)
+        {
+            first->right = merge(first->right, second);
+            update(first);
+            return first;
+        }
+        second->left = merge(first, second->left);
+        update(second);
+        return second;
+    }
+
+    // Splits the tree into the first [count] lines and the rest.
+    void split(Line* tree, std::size_t count, Line*& first, Line*& second)
+    {
+        if(tree == nullptr)
+        {
+            first = second = nullptr;
+            return;
+        }
+
+        if(size_of(tree->left) < count)
+        {
+            split(tree->right, count - size_of(tree->left) - 1,
+                  tree->right, second);
+            update(tree);
+            first = tree;
+        }
+        else
+        {
+            split(tree->left, count, first, tree->left);
+            update(tree);
+            second = tree;
+        }
+    }
+
+    Line* make_root(Line* tree)
+    {
+        if(tree != nullptr)
+            tree->parent = nullptr;
+        return tree;
+    }
+
+    void delete_tree(Line* tree)
+    {
+        if(tree == nullptr)
+            return;
+        delete_tree(tree->left);
+        delete_tree(tree->right);
+        delete tree;
+    }
+
+    std::size_t group_of(Line const* line)
+    {
+        return std::size_t{ line->name } * type_count
+            + element_priority(line->id.type());
+    }
+}
+
+Incremental_netlist::Incremental_netlist()
+{
+    // Node 0 is reported in the first batch, like in the full report.
+    connection_counts.emplace(0, 0);
+    touched_nodes.emplace(0, false);
+}
+
+Incremental_netlist::~Incremental_netlist()
+{
+    delete_tree(root);
+}
+
+std::size_t Incremental_netlist::line_count() const
+{
+    return size_of(root);
+}
+
+Line* Incremental_netlist::line_at(std::size_t index) const
+{
+    Line* line = root;
+    while(size_of(line->left) != index)
+    {
+        if(index < size_of(line->left))
+        {
+            line = line->left;
+        }
+        else
+        {
+            index -= size_of(line->left) + 1;
+            line = line->right;
+        }
+    }
+    return line;
+}
+
+std::size_t Incremental_netlist::index_of(Line const* line) const
+{
+    auto index = size_of(line->left);
+    for(; line->parent != nullptr; line = line->parent)
+    {
+        if(line == line->parent->right)
+            index += size_of(line->parent->left) + 1;
+    }
+    return index;
+}
+
+bool Incremental_netlist::insert_line(std::size_t line_no,
+                                      std::string_view text)
+{
+    if(line_no == 0 || line_no > line_count() + 1)
+        return false;
+
+    auto* line = new Line;
+    line->priority = random();
+
+    Line* before;
+    Line* after;
+    split(root, line_no - 1, before, after);
+    root = make_root(merge(merge(before, line), after));
+
+    // The new line is touched while it is still empty, so that it was not an
+    // error before.
+    touch_line(line);
+    line->text = text;
+    define(line);
+    return true;
+}
+
+bool Incremental_netlist::remove_line(std::size_t line_no)
+{
+    if(line_no == 0 || line_no > line_count())
+        return false;
+
+    Line* before;
+    Line* line;
+    Line* after;
+    split(root, line_no - 1, before, after);
+    split(after, 1, line, after);
+
+    // The line is gone, so its error is reported by its number.
+    auto touched = touched_lines.find(line);
+    bool was_error = touched != touched_lines.end() ? touched->second
+                                                    : is_error(line);
+    if(was_error)
+        removed_errors.push_back(line_no);
+
+    // Other lines are still in the tree, because undefine() may look up
+    // their positions.
+    root = make_root(merge(before, after));
+    undefine(line);
+    touched_lines.erase(line);
+    delete line;
+    return true;
+}
+
+bool Incremental_netlist::replace_line(std::size_t line_no,
+                                       std::string_view text)
+{
+    if(line_no == 0 || line_no > line_count())
+        return false;
+
+    auto* line = line_at(line_no - 1);
+    touch_line(line);
+    undefine(line);
+    line->text = text;
+    define(line);
+    return true;
+}
+
+void Incremental_netlist::define(Line* line)
+{
+    lexer::Parsed_line parsed;
+    line->correct = lexer::parse_line(line->text, parsed);
+    if(!line->correct)
+        return;
+
+    line->id = Id{ parsed.type, parsed.number };
+    line->name = names.intern(parsed.name);
+    std::copy(parsed.nodes, parsed.nodes + 3, line->nodes);
+    line->node_count = parsed.node_count;
+
+    auto& lines = definitions[line->id];
+    lines.push_back(line);
+    if(lines.size() == 1)
+    {
+        activate(line);
+        return;
+    }
+
+    // The line takes over the id only if it is before the active one.
+    auto active = std::find_if(lines.begin(), lines.end(),
+                               [](Line* other) { return other->active; });
+    if(index_of(line) < index_of(*active))
+    {
+        deactivate(*active);
+        activate(line);
+    }
+    else
+    {
+        touch_line(line);
+    }
+}
+
+void Incremental_netlist::undefine(Line* line)
+{
+    if(!line->correct)
+        return;
+
+    auto found = definitions.find(line->id);
+    auto& lines = found->second;
+    lines.erase(std::find(lines.begin(), lines.end(), line));
+    if(line->active)
+    {
+        deactivate(line);
+        if(!lines.empty())
+        {
+            activate(*std::min_element(lines.begin(), lines.end(),
+                                       [&](Line* lhs, Line* rhs) {
+                                           return index_of(lhs)
+                                               < index_of(rhs);
+                                       }));
+        }
+    }
+    if(lines.empty())
+        definitions.erase(found);
+    line->correct = false;
+}
+
+void Incremental_netlist::activate(Line* line)
+{
+    touch_line(line);
+    auto group = group_of(line);
+    touch_group(group);
+    groups[group].insert(line->id.number());
+    for(int i = 0; i < line->node_count; ++i)
+    {
+        touch_node(line->nodes[i]);
+        connection_counts[line->nodes[i]]++;
+    }
+    line->active = true;
+}
+
+void Incremental_netlist::deactivate(Line* line)
+{
+    touch_line(line);
+    auto group = group_of(line);
+    touch_group(group);
+    auto found = groups.find(group);
+    found->second.erase(line->id.number());
+    if(found->second.empty())
+        groups.erase(found);
+
+    for(int i = 0; i < line->node_count; ++i)
+    {
+        auto node = line->nodes[i];
+        touch_node(node);
+        auto count = connection_counts.find(node);
+
+        // Node disappears with its last element, except for node 0.
+        if(--count->second == 0 && node != 0)
+            connection_counts.erase(count);
+    }
+    line->active = false;
+}
+
+void Incremental_netlist::touch_line(Line* line)
+{
+    touched_lines.emplace(line, is_error(line));
+}
+
+void Incremental_netlist::touch_group(std::size_t group)
+{
+    if(touched_groups.count(group) != 0)
+        return;
+
+    auto found = groups.find(group);
+    auto first = found != groups.end() ? *found->second.begin()
+                                       : std::numeric_limits<int>::max();
+    touched_groups.emplace(group, Group_state{ group_text(group), first });
+}
+
+void Incremental_netlist::touch_node(int node)
+{
+    touched_nodes.emplace(node, is_unconnected(node));
+}
+
+bool Incremental_netlist::is_error(Line const* line) const
+{
+    return !line->text.empty() && !line->active;
+}
+
+bool Incremental_netlist::is_unconnected(int node) const
+{
+    auto found = connection_counts.find(node);
+    return found != connection_counts.end() && found->second < 2;
+}
+
+std::string Incremental_netlist::group_text(std::size_t group) const
+{
+    auto found = groups.find(group);
+    if(found == groups.end())
+        return std::string{};
+
+    char type = types_by_priority[group % type_count];
+    std::string text;
+    for(auto number : found->second)
+    {
+        if(!text.empty())
+            text += ", ";
+        text += type;
+        text += std::to_string(number);
+    }
+    text += ": ";
+    text += names[group / type_count];
+    return text;
+}
+
+void Incremental_netlist::report_changes(Buffered_writer& output)
+{
+    // Errors, in the line order. Removed lines have no Line any more.
+    std::vector<std::pair<std::size_t, Line*>> lines;
+    for(auto [line, was_error] : touched_lines)
+    {
+        if(was_error || is_error(line))
+            lines.emplace_back(index_of(line), line);
+    }
+    for(auto line_no : removed_errors)
+        lines.emplace_back(line_no - 1, nullptr);
+    std::sort(lines.begin(), lines.end());
+    for(auto [index, line] : lines)
+    {
+        bool error = line != nullptr && is_error(line);
+        output.write(error ? "+ " : "- ");
+        output.write("Error in line ");
+        output.write_number(index + 1);
+        if(error)
+        {
+            output.write(": ");
+            output.write(line->text);
+        }
+        output.write('\n');
+    }
+
+    // Groups, in the order of the full report, by their first elements
+    // (or the old ones, if the group is gone).
+    std::vector<std::tuple<int, int, std::size_t>> changed_groups;
+    for(auto const& [group, state] : touched_groups)
+    {
+        auto found = groups.find(group);
+        auto first = found != groups.end() ? *found->second.begin()
+                                           : state.first;
+        changed_groups.emplace_back(group % type_count, first, group);
+    }
+    std::sort(changed_groups.begin(), changed_groups.end());
+    for(auto [priority, first, group] : changed_groups)
+    {
+        auto const& old_text = touched_groups[group].text;
+        auto new_text = group_text(group);
+        if(old_text == new_text)
+            continue;
+
+        if(!old_text.empty())
+        {
+            output.write("- ");
+            output.write(old_text);
+            output.write('\n');
+        }
+        if(!new_text.empty())
+        {
+            output.write("+ ");
+            output.write(new_text);
+            output.write('\n');
+        }
+    }
+
+    // Unconnected nodes, those no longer unconnected first.
+    std::vector<std::uint64_t> connected_nodes;
+    std::vector<std::uint64_t> unconnected_nodes;
+    for(auto [node, was_unconnected] : touched_nodes)
+    {
+        if(was_unconnected && !is_unconnected(node))
+            connected_nodes.push_back(node);
+        else if(!was_unconnected && is_unconnected(node))
+            unconnected_nodes.push_back(node);
+    }
+    for(auto* nodes : { &connected_nodes, &unconnected_nodes })
+    {
+        if(nodes->empty())
+            continue;
+
+        std::sort(nodes->begin(), nodes->end());
+        output.write(nodes == &connected_nodes ? "- " : "+ ");
+        output.write("Warning, unconnected node(s): ");
+        for(auto i = nodes->begin(); i != nodes->end(); ++i)
+        {
+            if(i != nodes->begin())
+                output.write(", ");
+            output.write_number(*i);
+        }
+        output.write('\n');
+    }
+    output.write(".\n");
+
+    touched_lines.clear();
+    removed_errors.clear();
+    touched_groups.clear();
+    touched_nodes.clear();
+}
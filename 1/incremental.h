@@ -0,0 +1,124 @@
+#ifndef INCREMENTAL_H
+#define INCREMENTAL_H
+
+#include <cstddef>
+#include <cstdint>
+#include <random>
+#include <set>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "netlist.h"
+#include "report.h"
+
+// Netlist kept up to date under line edits, for the editors which rerun the
+// analysis after every change.
+namespace obwody
+{
+    // The netlist of the edited text. Lines are inserted, removed and
+    // replaced one at a time, and only the elements, groups and nodes touched
+    // by the edit are updated, so the cost of the edit does not depend on the
+    // size of the netlist (apart from the logarithmic line lookup).
+    //
+    // The result is the same as if the whole text was parsed again: an
+    // element is defined by the first correct line with its id, and all the
+    // other lines with that id are errors. Sub-circuits not connected to the
+    // ground are not reported, because the union-find used for them can not
+    // remove connections.
+    class Incremental_netlist
+    {
+    public:
+        Incremental_netlist();
+        ~Incremental_netlist();
+
+        Incremental_netlist(Incremental_netlist const&) = delete;
+        Incremental_netlist& operator=(Incremental_netlist const&) = delete;
+
+        std::size_t line_count() const;
+
+        // Edits of the text. Lines are numbered from 1, and the new line can
+        // also be inserted at line_count() + 1. Return false if the line
+        // number is out of range.
+        bool insert_line(std::size_t line_no, std::string_view text);
+        bool remove_line(std::size_t line_no);
+        bool replace_line(std::size_t line_no, std::string_view text);
+
+        // Writes what has changed since the previous report and starts
+        // collecting the changes anew. Every line of the report starts with
+        // "+ " (appeared) or "- " (disappeared), followed by the line of the
+        // full report:
+        // - errors of the edited lines and of the lines whose duplicated id
+        //   has been resolved, with their current numbers ("- Error in
+        //   line N" means that the line is correct now), and of the removed
+        //   lines, with the numbers they had when they were removed,
+        // - changed groups, the old version first,
+        // - nodes which became unconnected, or stopped being unconnected.
+        // The report ends with a line containing a single dot.
+        void report_changes(Buffered_writer& output);
+
+        // Line of the text, defined in incremental.cc.
+        struct Line;
+
+    private:
+        struct Group_state
+        {
+            std::string text;   // Line of the report, empty if no elements.
+            int first;          // Number of the first element.
+        };
+
+        // Lines are kept in a treap ordered by their position in the text,
+        // so that the line can be found by its number, and its number
+        // computed, in logarithmic time.
+        Line* line_at(std::size_t index) const;
+        std::size_t index_of(Line const* line) const;
+
+        // Parses the line and adds its element to the netlist, if it is the
+        // first definition of its id.
+        void define(Line* line);
+
+        // Reverts what define() did, activating the next definition of the
+        // id if the line was the active one.
+        void undefine(Line* line);
+
+        void activate(Line* line);
+        void deactivate(Line* line);
+
+        // Remember the state from before the first change in the batch.
+        void touch_line(Line* line);
+        void touch_group(std::size_t group);
+        void touch_node(int node);
+
+        bool is_error(Line const* line) const;
+        bool is_unconnected(int node) const;
+        std::string group_text(std::size_t group) const;
+
+        Line* root{ nullptr };
+        std::mt19937 random;
+
+        Name_pool names;
+
+        // All correct lines of the id, the earliest one is the active
+        // definition.
+        std::unordered_map<Id, std::vector<Line*>, Id_hash> definitions;
+
+        // Numbers of the elements of every group, which is identified by
+        // name * type_count + priority of the type.
+        std::unordered_map<std::size_t, std::set<int>> groups;
+
+        // Number of the elements connected to every node. Node 0 is always
+        // there.
+        std::unordered_map<int, std::uint32_t> connection_counts;
+
+        // State from before the current batch of edits.
+        std::unordered_map<Line*, bool> touched_lines;
+        std::unordered_map<std::size_t, Group_state> touched_groups;
+        std::unordered_map<int, bool> touched_nodes;
+
+        // Numbers of the removed lines which were errors before the batch.
+        std::vector<std::size_t> removed_errors;
+    };
+}
+
+#endif
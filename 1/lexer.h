@@ -0,0 +1,251 @@
+#ifndef LEXER_H
+#define LEXER_H
+
+#include <cstddef>
+#include <string_view>
+#include <utility>
+
+#include "scan.h"
+
+// Hand written lexer for the netlist lines. It accepts exactly the same lines
+// as the regular expression below (which was used by the first version of the
+// program) but does a single pass over the line and never allocates:
+//
+//     ^\s*
+//     (?:([DRCE](?:0|[1-9][0-9]{0,8}))\s+
+//     ((?:[A-Z]|[0-9])(?:[A-Za-z0-9]|,|-|\/)*)\s+
+//     (0|[1-9][0-9]{0,8})\s+
+//     (0|[1-9][0-9]{0,8})|
+//     (?:(T(?:0|[1-9][0-9]{0,8}))\s+
+//     ((?:[A-Z]|[0-9])(?:[A-Za-z0-9]|,|-|\/)*))\s+
+//     (0|[1-9][0-9]{0,8})\s+
+//     (0|[1-9][0-9]{0,8})\s+
+//     (0|[1-9][0-9]{0,8}))
+//     \s*$
+//
+// None of the tokens can contain a whitespace and every token is followed by
+// a whitespace or the end of the line, so the grammar is in fact a simple DFA
+// and no backtracking is ever needed.
+namespace lexer
+{
+    // Single, correctly parsed line. Views point into the lexed line, so they
+    // are valid as long as the line is.
+    struct Parsed_line
+    {
+        char type;              // D, R, C, E or T.
+        int number;             // The number in the element id.
+        std::string_view id;    // Whole id token, eg. "T12".
+        std::string_view name;  // The type of the element, eg. "BC107".
+
+        // Nodes the element is connected to, sorted and without duplicates.
+        // Only first [node_count] values are meaningful.
+        int nodes[3];
+        int node_count;
+    };
+
+    // Same set of characters as \s in the std::regex ECMAScript grammar.
+    inline bool is_space(char c)
+    {
+        return c == ' ' || (c >= '\t' && c <= '\r');
+    }
+
+    inline bool is_digit(char c)
+    {
+        return c >= '0' && c <= '9';
+    }
+
+    inline bool is_name_start(char c)
+    {
+        return (c >= 'A' && c <= 'Z') || is_digit(c);
+    }
+
+    inline bool is_name_char(char c)
+    {
+        return is_name_start(c) || (c >= 'a' && c <= 'z')
+            || c == ',' || c == '-' || c == '/';
+    }
+
+    // Character classes of the line, used to find where the runs of
+    // whitespaces, digits and name characters end. Scalar_classes checks the
+    // characters one by one, Mask_classes uses the masks computed by the scan
+    // kernels for the whole input at once.
+    struct Scalar_classes
+    {
+        std::string_view line;
+
+        std::size_t spaces_end(std::size_t pos) const
+        {
+            while(pos < line.size() && is_space(line[pos]))
+                ++pos;
+            return pos;
+        }
+
+        std::size_t digits_end(std::size_t pos) const
+        {
+            while(pos < line.size() && is_digit(line[pos]))
+                ++pos;
+            return pos;
+        }
+
+        std::size_t name_chars_end(std::size_t pos) const
+        {
+            while(pos < line.size() && is_name_char(line[pos]))
+                ++pos;
+            return pos;
+        }
+    };
+
+    struct Mask_classes
+    {
+        scan::Masks masks;
+
+        std::size_t spaces_end(std::size_t pos) const
+        {
+            return scan::run_end(masks.spaces, pos);
+        }
+
+        std::size_t digits_end(std::size_t pos) const
+        {
+            return scan::run_end(masks.digits, pos);
+        }
+
+        std::size_t name_chars_end(std::size_t pos) const
+        {
+            return scan::run_end(masks.name_chars, pos);
+        }
+    };
+
+    // Lexes the number matching (0|[1-9][0-9]{0,8}). Because the number must
+    // be followed by a whitespace or the end of the line, we can greedly take
+    // all digits and then reject too long or zero-prefixed numbers.
+    template<typename Classes>
+    bool lex_number(std::string_view line, Classes const& classes,
+                    std::size_t& pos, int& value)
+    {
+        auto start = pos;
+        pos = classes.digits_end(pos);
+        auto length = pos - start;
+        if(length == 0 || length > 9 || (length > 1 && line[start] == '0'))
+            return false;
+
+        int result{ 0 };
+        for(auto i = start; i < pos; ++i)
+            result = result * 10 + (line[i] - '0');
+        value = result;
+        return true;
+    }
+
+    // Checks that the token ends here, that is, it is followed by at least one
+    // whitespace, or, if [last] is set, by the end of the line.
+    template<typename Classes>
+    bool token_end(std::string_view line, Classes const& classes,
+                   std::size_t& pos, bool last)
+    {
+        auto start = pos;
+        pos = classes.spaces_end(pos);
+        if(last)
+            return pos == line.size();
+        return pos > start && pos < line.size();
+    }
+
+    // Lexes the line. Returns true if the line matches the grammar and the
+    // element is connected to at least two different nodes. Only then the
+    // [result] is filled.
+    template<typename Classes>
+    bool parse_line(std::string_view line, Classes const& classes,
+                    Parsed_line& result)
+    {
+        std::size_t pos = classes.spaces_end(0);
+        if(pos == line.size())
+            return false;
+
+        char type = line[pos];
+        int node_count;
+        switch(type)
+        {
+            case 'D': case 'R': case 'C': case 'E':
+                node_count = 2;
+                break;
+            case 'T':
+                node_count = 3;
+                break;
+            default:
+                return false;
+        }
+
+        auto id_start = pos++;
+        if(!lex_number(line, classes, pos, result.number))
+            return false;
+        result.id = line.substr(id_start, pos - id_start);
+        if(!token_end(line, classes, pos, false))
+            return false;
+
+        auto name_start = pos;
+        if(!is_name_start(line[pos]))
+            return false;
+        pos = classes.name_chars_end(pos);
+        result.name = line.substr(name_start, pos - name_start);
+        if(!token_end(line, classes, pos, false))
+            return false;
+
+        int* nodes = result.nodes;
+        nodes[2] = 0;
+        for(int i = 0; i < node_count; ++i)
+        {
+            if(!lex_number(line, classes, pos, nodes[i])
+               || !token_end(line, classes, pos, i == node_count - 1))
+            {
+                return false;
+            }
+        }
+
+        // Sort the nodes and drop duplicates. There is at most three of them,
+        // so it is done by hand.
+        if(nodes[0] > nodes[1])
+            std::swap(nodes[0], nodes[1]);
+        if(node_count == 3)
+        {
+            if(nodes[1] > nodes[2])
+                std::swap(nodes[1], nodes[2]);
+            if(nodes[0] > nodes[1])
+                std::swap(nodes[0], nodes[1]);
+
+            if(nodes[1] == nodes[2])
+                --node_count;
+            if(nodes[0] == nodes[1])
+            {
+                nodes[1] = nodes[2];
+                --node_count;
+            }
+        }
+        else if(nodes[0] == nodes[1])
+        {
+            --node_count;
+        }
+
+        // Element connected to only one node is incorrect.
+        if(node_count == 1)
+            return false;
+
+        result.type = type;
+        result.node_count = node_count;
+        return true;
+    }
+
+    inline bool parse_line(std::string_view line, Parsed_line& result)
+    {
+        return parse_line(line, Scalar_classes{ line }, result);
+    }
+
+    // Lexes the line using its masks from the scan::Line_scanner, if it has
+    // them.
+    inline bool parse_line(std::string_view line, scan::Masks const* masks,
+                           Parsed_line& result)
+    {
+        if(masks != nullptr)
+            return parse_line(line, Mask_classes{ *masks }, result);
+        return parse_line(line, Scalar_classes{ line }, result);
+    }
+}
+
+#endif
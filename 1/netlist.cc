@@ -0,0 +1,436 @@
+#include <iostream>
+#include <string>
+#include <thread>
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "netlist.h"
+#include "scan.h"
+#include "stats.h"
+
+using obwody::Error_log;
+using obwody::Id;
+using obwody::Id_hash;
+using obwody::Id_set;
+using obwody::Netlist;
+using obwody::Phase_timer;
+using obwody::Stats;
+
+namespace
+{
+    // Parallel parsing. The input is processed in rounds of about
+    // [round_size] bytes, so that the memory used for the parsed lines does not
+    // depend on the input size. Every round is split into newline-aligned
+    // chunks, one for each thread, and goes through three phases:
+    // 1. Every thread lexes its chunk.
+    // 2. Every thread checks for duplicated ids in its shard of the id space.
+    //    Thread s sees the ids with hash % threads == s in the line order, so
+    //    it decides exactly the same as the sequential version would.
+    // 3. Every thread adds the correct elements of its chunk to its partial
+    //    result. Partial results are merged after the last round.
+    // Errors are printed after every round, in chunk order, so they come out
+    // in line-number order.
+    constexpr std::size_t round_size{ 64 << 20 };
+
+    // Runs f(0), ..., f(count - 1) on separate threads and waits for them.
+    template<typename F>
+    void run_parallel(std::size_t count, F f)
+    {
+        std::vector<std::thread> threads;
+        threads.reserve(count);
+        for(std::size_t i = 0; i < count; ++i)
+            threads.emplace_back(f, i);
+        for(auto& thread : threads)
+            thread.join();
+    }
+
+    // Returns the length of the prefix of [data] which is at least [size]
+    // bytes long (unless [data] is shorter) and ends after a newline.
+    std::size_t line_aligned_end(std::string_view data, std::size_t size)
+    {
+        if(size >= data.size())
+            return data.size();
+        auto const* end = data.data() + data.size();
+        auto const* newline = scan::find_newline(
+            data.data() + (size == 0 ? 0 : size - 1), end);
+        return newline == end ? data.size() : newline - data.data() + 1;
+    }
+
+    // Reads the file in newline-aligned parts. If the file is a regular file
+    // it is memory mapped, otherwise it is read in large blocks.
+    class Input_reader
+    {
+    public:
+        explicit Input_reader(int fd_) : fd{ fd_ }
+        {
+            struct stat file_stat;
+            if(fstat(fd, &file_stat) == 0 && S_ISREG(file_stat.st_mode)
+               && file_stat.st_size > 0)
+            {
+                auto size = static_cast<std::size_t>(file_stat.st_size);
+                void* mapped = mmap(nullptr, size, PROT_READ, MAP_PRIVATE,
+                                    fd, 0);
+                if(mapped != MAP_FAILED)
+                {
+                    madvise(mapped, size, MADV_SEQUENTIAL);
+                    mapping = std::string_view{
+                        static_cast<char const*>(mapped), size };
+                }
+            }
+        }
+
+        ~Input_reader()
+        {
+            if(mapping.data() != nullptr)
+                munmap(const_cast<char*>(mapping.data()), mapping.size());
+        }
+
+        Input_reader(Input_reader const&) = delete;
+        Input_reader& operator=(Input_reader const&) = delete;
+
+        // Returns the next part of the input of about [size] bytes, which ends
+        // just after a newline or at the end of the input. The view is valid
+        // until the next call. Returns an empty view at the end of the input.
+        std::string_view next(std::size_t size)
+        {
+            if(mapping.data() != nullptr)
+            {
+                auto rest = mapping.substr(consumed);
+                auto part = rest.substr(0, line_aligned_end(rest, size));
+                consumed += part.size();
+                return part;
+            }
+
+            buffer.erase(0, consumed);
+            consumed = 0;
+            while(!end_of_input && (buffer.size() < size
+                                    || buffer.find('\n') == std::string::npos))
+            {
+                auto old_size = buffer.size();
+                buffer.resize(old_size + block_size);
+                auto bytes = read(fd, buffer.data() + old_size, block_size);
+                buffer.resize(old_size + (bytes > 0 ? bytes : 0));
+                end_of_input = bytes <= 0;
+            }
+
+            std::string_view data{ buffer };
+            consumed = end_of_input ? data.size()
+                                    : data.rfind('\n') + 1;
+            return data.substr(0, consumed);
+        }
+
+    private:
+        static constexpr std::size_t block_size{ 1 << 20 };
+
+        int fd;
+        std::string_view mapping{};
+        std::string buffer{};
+        std::size_t consumed{ 0 };
+        bool end_of_input{ false };
+    };
+
+    // Splits the data into at most [count] newline-aligned chunks of similar
+    // size.
+    std::vector<std::string_view> split_into_chunks(std::string_view data,
+                                                    std::size_t count)
+    {
+        std::vector<std::string_view> chunks;
+        auto chunk_size = data.size() / count + 1;
+        while(!data.empty())
+        {
+            auto length = line_aligned_end(data, chunk_size);
+            chunks.push_back(data.substr(0, length));
+            data.remove_prefix(length);
+        }
+        return chunks;
+    }
+
+    // Single non-empty line of the chunk. [line_no] is counted from the
+    // beginning of the chunk.
+    struct Line_record
+    {
+        std::size_t line_no;
+        std::string_view line;
+        lexer::Parsed_line parsed;
+        bool correct;
+    };
+
+    struct Chunk
+    {
+        std::vector<Line_record> records;
+
+        // Indices of correct records whose id falls into the given shard.
+        std::vector<std::vector<std::size_t>> shard_records;
+
+        // Lines with errors, in order, filled in the third phase.
+        std::vector<Line_record const*> errors;
+        std::size_t line_count{ 0 };
+    };
+
+    // First phase: lexes all lines of the chunk.
+    void lex_chunk(std::string_view data, Chunk& chunk, std::size_t shards)
+    {
+        chunk.shard_records.assign(shards, {});
+        Id_hash hash;
+        scan::Line_scanner scanner{ data.data(), data.data() + data.size() };
+        std::string_view line;
+        scan::Masks const* masks;
+        while(scanner.next(line, masks))
+        {
+            ++chunk.line_count;
+
+            if(line.empty())
+                continue;
+
+            Line_record record;
+            record.line_no = chunk.line_count;
+            record.line = line;
+            record.correct = lexer::parse_line(line, masks, record.parsed);
+            if(record.correct)
+            {
+                Id id{ record.parsed.type, record.parsed.number };
+                chunk.shard_records[hash(id) % shards]
+                    .push_back(chunk.records.size());
+            }
+            chunk.records.push_back(record);
+        }
+    }
+
+    // Second phase: marks the lines with repeated ids of the given shard as
+    // incorrect. [used_ids] contains ids of the shard from previous rounds.
+    void check_shard_ids(std::vector<Chunk>& chunks, std::size_t shard,
+                         Id_set& used_ids)
+    {
+        for(auto& chunk : chunks)
+        {
+            for(auto index : chunk.shard_records[shard])
+            {
+                auto& record = chunk.records[index];
+                auto const& parsed = record.parsed;
+                if(!used_ids.emplace(parsed.type, parsed.number).second)
+                    record.correct = false;
+            }
+        }
+    }
+
+    // Third phase: adds the correct lines of the chunk to the partial result
+    // and collects the incorrect ones.
+    void add_chunk(Chunk& chunk, Netlist& netlist)
+    {
+        for(auto const& record : chunk.records)
+        {
+            if(!record.correct)
+            {
+                chunk.errors.push_back(&record);
+                continue;
+            }
+
+            netlist.add_element(record.parsed);
+        }
+    }
+
+    // Reads the line, timing it only in the timed version of the parser.
+    template<bool timed>
+    bool read_line(std::istream& input, std::string& line, Stats* stats)
+    {
+        Phase_timer timer{ timed ? stats : nullptr, Stats::read };
+        return static_cast<bool>(std::getline(input, line));
+    }
+
+    // The same as process_input_line(), with every step timed.
+    bool process_timed_line(std::string_view line,
+                            Id_set& used_ids,
+                            Netlist& netlist,
+                            Stats& stats)
+    {
+        if(line.empty())
+            return true;
+
+        lexer::Parsed_line parsed;
+        {
+            Phase_timer timer{ &stats, Stats::lex };
+            if(!lexer::parse_line(line, parsed))
+                return false;
+        }
+        {
+            Phase_timer timer{ &stats, Stats::ids };
+            if(!used_ids.emplace(parsed.type, parsed.number).second)
+                return false;
+        }
+        Phase_timer timer{ &stats, Stats::add };
+        netlist.add_element(parsed);
+        return true;
+    }
+
+    // The sequential parser. The version which is not timed does not even
+    // look at the stats until the end.
+    template<bool timed>
+    Netlist parse_lines(std::istream& input, Error_log& error_log,
+                        Stats* stats)
+    {
+        Netlist netlist;
+        Id_set used_ids;
+        std::string line;
+        std::size_t line_no{ 1 };
+        for(; read_line<timed>(input, line, stats); ++line_no)
+        {
+            bool correct;
+            if constexpr(timed)
+                correct = process_timed_line(line, used_ids, netlist, *stats);
+            else
+                correct = obwody::process_input_line(line, used_ids, netlist);
+            if(!correct)
+            {
+                Phase_timer timer{ timed ? stats : nullptr, Stats::errors };
+                error_log.report(line_no, line);
+            }
+        }
+
+        if(stats != nullptr)
+        {
+            stats->line_count += line_no - 1;
+            stats->used_ids.add(used_ids);
+        }
+        return netlist;
+    }
+}
+
+void Error_log::report(std::size_t line_no, std::string_view line)
+{
+    ++count;
+    if(print)
+        std::cerr << "Error in line " << line_no << ": " << line << '\n';
+    if(keep)
+    {
+        lines.push_back(line_no);
+        text.append(line);
+        text_offsets.push_back(text.size());
+    }
+}
+
+// Fills the stamp of the open file. Returns false if it is not a regular
+// file (eg. a pipe), which can not be cached.
+bool obwody::get_source_stamp(int fd, Source_stamp& stamp)
+{
+    struct stat file_stat;
+    if(fstat(fd, &file_stat) != 0 || !S_ISREG(file_stat.st_mode))
+        return false;
+
+    stamp = Source_stamp{ static_cast<std::uint64_t>(file_stat.st_dev),
+                          static_cast<std::uint64_t>(file_stat.st_ino),
+                          static_cast<std::uint64_t>(file_stat.st_size),
+                          file_stat.st_mtim.tv_sec,
+                          file_stat.st_mtim.tv_nsec };
+    return true;
+}
+
+// Process the single input line. If line is empty it will do nothing,
+// otherwise it updates the data structures
+bool obwody::process_input_line(std::string_view line,
+                                Id_set& used_ids,
+                                Netlist& netlist,
+                                scan::Masks const* masks)
+{
+    if(line.empty())
+        return true;
+
+    lexer::Parsed_line parsed;
+    if (!lexer::parse_line(line, masks, parsed))
+        return false;
+
+    // If the second value of the pair returned by insert is false, this
+    // means the value were already there and we should return false.
+    bool insertion_result{
+        used_ids.emplace(parsed.type, parsed.number).second };
+    if(!insertion_result)
+        return false;
+
+    netlist.add_element(parsed);
+    return true;
+}
+
+Netlist obwody::parse_sequential(std::istream& input, Error_log& error_log,
+                                 Stats* stats)
+{
+    if(stats != nullptr)
+        return parse_lines<true>(input, error_log, stats);
+    return parse_lines<false>(input, error_log, stats);
+}
+
+Netlist obwody::parse_text(std::string_view text, Error_log& error_log)
+{
+    Netlist netlist;
+    Id_set used_ids;
+    scan::Line_scanner scanner{ text.data(), text.data() + text.size() };
+    std::string_view line;
+    scan::Masks const* masks;
+    for(std::size_t line_no{ 1 }; scanner.next(line, masks); ++line_no)
+    {
+        if(!process_input_line(line, used_ids, netlist, masks))
+            error_log.report(line_no, line);
+    }
+    return netlist;
+}
+
+Netlist obwody::parse_parallel(int fd, std::size_t thread_count,
+                               Error_log& error_log, Stats* stats)
+{
+    Input_reader reader{ fd };
+    std::vector<Id_set> used_ids(thread_count);
+    std::vector<Netlist> partial_results(thread_count);
+    std::size_t lines_before{ 0 };
+
+    auto next_round = [&] {
+        Phase_timer timer{ stats, Stats::read };
+        return reader.next(round_size);
+    };
+    for(auto data = next_round(); !data.empty(); data = next_round())
+    {
+        auto chunk_data = split_into_chunks(data, thread_count);
+        std::vector<Chunk> chunks(chunk_data.size());
+
+        {
+            Phase_timer timer{ stats, Stats::lex };
+            run_parallel(chunks.size(), [&](std::size_t i) {
+                lex_chunk(chunk_data[i], chunks[i], thread_count);
+            });
+        }
+        {
+            Phase_timer timer{ stats, Stats::ids };
+            run_parallel(thread_count, [&](std::size_t shard) {
+                check_shard_ids(chunks, shard, used_ids[shard]);
+            });
+        }
+        {
+            Phase_timer timer{ stats, Stats::add };
+            run_parallel(chunks.size(), [&](std::size_t i) {
+                add_chunk(chunks[i], partial_results[i]);
+            });
+        }
+
+        Phase_timer timer{ stats, Stats::errors };
+        for(auto const& chunk : chunks)
+        {
+            for(auto const* record : chunk.errors)
+            {
+                error_log.report(lines_before + record->line_no,
+                                 record->line);
+            }
+            lines_before += chunk.line_count;
+        }
+    }
+
+    if(stats != nullptr)
+    {
+        stats->line_count += lines_before;
+        for(auto const& shard_ids : used_ids)
+            stats->used_ids.add(shard_ids);
+    }
+
+    Phase_timer timer{ stats, Stats::merge };
+    for(std::size_t i = 1; i < thread_count; ++i)
+        partial_results[0].merge(partial_results[i]);
+    return std::move(partial_results[0]);
+}
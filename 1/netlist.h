@@ -0,0 +1,469 @@
+#ifndef NETLIST_H
+#define NETLIST_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <iosfwd>
+#include <limits>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+#include "lexer.h"
+
+// Parsing of the netlist into the list of correct elements, which the other
+// parts of the program (and the programs embedding it) build upon.
+namespace obwody
+{
+    // The element Id packed into a single 64-bit key: the type letter is kept
+    // in bits 32-39 and the number in the lower 32 bits.
+    struct Id
+    {
+        std::uint64_t key;
+
+        Id() = default;
+        Id(char type, int number)
+            : key{ (std::uint64_t{ static_cast<unsigned char>(type) } << 32)
+                   | static_cast<std::uint32_t>(number) }
+        {
+        }
+
+        char type() const
+        {
+            return static_cast<char>(key >> 32);
+        }
+
+        int number() const
+        {
+            return static_cast<int>(key & 0xffffffff);
+        }
+
+        bool operator==(Id other) const
+        {
+            return key == other.key;
+        }
+    };
+
+    struct Id_hash
+    {
+        std::size_t operator()(Id id) const
+        {
+            return std::hash<std::uint64_t>{}(id.key);
+        }
+    };
+
+    // Index of the interned name in the Name_pool.
+    using Name = std::uint32_t;
+
+    // Stores every distinct name once. Characters of the names are kept in
+    // large blocks, so there is no allocation per name.
+    class Name_pool
+    {
+    public:
+        Name intern(std::string_view name)
+        {
+            auto found = index.find(name);
+            if(found != index.end())
+                return found->second;
+
+            auto stored = store(name);
+            Name result = static_cast<Name>(names.size());
+            names.push_back(stored);
+            index.emplace(stored, result);
+            return result;
+        }
+
+        std::string_view operator[](Name name) const
+        {
+            return names[name];
+        }
+
+        std::size_t size() const
+        {
+            return names.size();
+        }
+
+        std::size_t bucket_count() const
+        {
+            return index.bucket_count();
+        }
+
+    private:
+        static constexpr std::size_t block_size{ 1 << 16 };
+
+        // Copies the name into the current block, or into the new one if it
+        // does not fit.
+        std::string_view store(std::string_view name)
+        {
+            if(block_used + name.size() > block_capacity)
+            {
+                block_capacity = std::max(block_size, name.size());
+                blocks.emplace_back(new char[block_capacity]);
+                block_used = 0;
+            }
+
+            char* destination = blocks.back().get() + block_used;
+            std::memcpy(destination, name.data(), name.size());
+            block_used += name.size();
+            return std::string_view{ destination, name.size() };
+        }
+
+        std::vector<std::unique_ptr<char[]>> blocks;
+        std::size_t block_used{ 0 };
+        std::size_t block_capacity{ 0 };
+        std::vector<std::string_view> names;
+        std::unordered_map<std::string_view, Name> index;
+    };
+
+    // Defines the prority for the given type when sorting the lists of
+    // elements. The lower value, the higher proprity type has. X are the
+    // instances of the subcircuits, see subcircuit.h.
+    constexpr char types_by_priority[]{ "TDRCEX" };
+    constexpr int type_count{ 6 };
+
+    inline int element_priority(char type)
+    {
+        switch(type)
+        {
+            case 'T': return 0;
+            case 'D': return 1;
+            case 'R': return 2;
+            case 'C': return 3;
+            case 'E': return 4;
+            default: return 5;
+        }
+    }
+
+    // Connection counts and connectivity of the nodes. Every node gets a
+    // compact index, under which its counter and union-find parent are kept.
+    // Node numbers are mapped to indices with a plain array, which only grows
+    // while it stays proportional to the number of nodes, and the numbers
+    // beyond it go through a hash map. Every node below the size of the
+    // array is kept in the array, so the hash map has only the larger ones.
+    class Node_table
+    {
+    public:
+        using Index = std::uint32_t;
+        static constexpr auto no_index = std::numeric_limits<Index>::max();
+
+        // Makes sure the node exists, even if nothing is connected to it.
+        void add_node(int node)
+        {
+            index_of(node);
+        }
+
+        // Adds the element connected to the given (different) nodes.
+        void connect(int const* element_nodes, int count)
+        {
+            auto first = index_of(element_nodes[0]);
+            counts[first]++;
+            for(int i = 1; i < count; ++i)
+            {
+                auto index = index_of(element_nodes[i]);
+                counts[index]++;
+                unite(first, index);
+            }
+        }
+
+        // Adds the connections made inside a subcircuit instance to the node
+        // it is bound to. Deeply nested instances may stand for more elements
+        // than an int can count, so the count saturates.
+        void add_connections(int node, int count)
+        {
+            auto& current = counts[index_of(node)];
+            if(count > std::numeric_limits<int>::max() - current)
+                current = std::numeric_limits<int>::max();
+            else
+                current += count;
+        }
+
+        // Connects the nodes, which are connected inside a subcircuit
+        // instance, without adding any connections.
+        void join(int lhs, int rhs)
+        {
+            unite(index_of(lhs), index_of(rhs));
+        }
+
+        std::size_t size() const
+        {
+            return nodes.size();
+        }
+
+        // Sizes of the array and of the hash map of the node indices.
+        std::size_t dense_size() const
+        {
+            return dense_index.size();
+        }
+
+        std::size_t sparse_size() const
+        {
+            return sparse_index.size();
+        }
+
+        std::size_t sparse_bucket_count() const
+        {
+            return sparse_index.bucket_count();
+        }
+
+        // Adds all connections of the [other] table to this one.
+        void merge(Node_table& other)
+        {
+            std::vector<Index> other_to_this(other.nodes.size());
+            for(Index i = 0; i < other.nodes.size(); ++i)
+            {
+                other_to_this[i] = index_of(other.nodes[i]);
+                counts[other_to_this[i]] += other.counts[i];
+            }
+            for(Index i = 0; i < other.nodes.size(); ++i)
+                unite(other_to_this[i], other_to_this[other.find(i)]);
+
+            other = Node_table{};
+        }
+
+        // Returns the index of the existing node, or [no_index].
+        Index find_index(int node) const
+        {
+            if(static_cast<std::size_t>(node) < dense_index.size())
+                return dense_index[node] - 1;
+
+            auto found = sparse_index.find(node);
+            return found == sparse_index.end() ? no_index : found->second - 1;
+        }
+
+        int node(Index index) const
+        {
+            return nodes[index];
+        }
+
+        int connection_count(Index index) const
+        {
+            return counts[index];
+        }
+
+        // Returns indices of all nodes, in increasing node order.
+        std::vector<Index> indices_in_order() const
+        {
+            std::vector<Index> result;
+            result.reserve(nodes.size());
+            for(auto slot : dense_index)
+                if(slot != 0)
+                    result.push_back(slot - 1);
+
+            // The hash map has only the nodes beyond the array.
+            std::vector<std::pair<int, Index>> sparse(sparse_index.begin(),
+                                                      sparse_index.end());
+            std::sort(sparse.begin(), sparse.end());
+            for(auto const& node_slot_pair : sparse)
+                result.push_back(node_slot_pair.second - 1);
+            return result;
+        }
+
+        // Returns the representative of the node's component. Union-find with
+        // path halving and union by size.
+        Index find(Index index)
+        {
+            while(parents[index] != index)
+            {
+                parents[index] = parents[parents[index]];
+                index = parents[index];
+            }
+            return index;
+        }
+
+    private:
+        // The array may have this many slots more than twice the number of
+        // the nodes.
+        static constexpr std::size_t dense_slack{ 1 << 16 };
+
+        Index index_of(int node)
+        {
+            auto position = static_cast<std::size_t>(node);
+            if(position >= dense_index.size())
+                grow_dense_index(position);
+
+            Index* slot;
+            if(position < dense_index.size())
+                slot = &dense_index[position];
+            else
+                slot = &sparse_index[node];
+
+            // Indices are stored increased by one, 0 marks a missing node.
+            if(*slot == 0)
+            {
+                *slot = nodes.size() + 1;
+                nodes.push_back(node);
+                counts.push_back(0);
+                parents.push_back(nodes.size() - 1);
+                sizes.push_back(1);
+            }
+            return *slot - 1;
+        }
+
+        // Grows the array to hold the node, if it stays proportional to the
+        // number of the nodes, and moves the nodes it now covers out of the
+        // hash map.
+        void grow_dense_index(std::size_t position)
+        {
+            auto limit = 2 * nodes.size() + dense_slack;
+            if(position >= limit)
+                return;
+
+            dense_index.resize(std::min(
+                limit, std::max(position + 1, 2 * dense_index.size())));
+            for(auto it = sparse_index.begin(); it != sparse_index.end();)
+            {
+                auto moved = static_cast<std::size_t>(it->first);
+                if(moved < dense_index.size())
+                {
+                    dense_index[moved] = it->second;
+                    it = sparse_index.erase(it);
+                }
+                else
+                {
+                    ++it;
+                }
+            }
+        }
+
+        void unite(Index lhs, Index rhs)
+        {
+            lhs = find(lhs);
+            rhs = find(rhs);
+            if(lhs == rhs)
+                return;
+            if(sizes[lhs] < sizes[rhs])
+                std::swap(lhs, rhs);
+            parents[rhs] = lhs;
+            sizes[lhs] += sizes[rhs];
+        }
+
+        std::vector<Index> dense_index;
+        std::unordered_map<int, Index> sparse_index;
+
+        // Indexed by the node index.
+        std::vector<int> nodes;
+        std::vector<int> counts;
+        std::vector<Index> parents;
+        std::vector<Index> sizes;
+    };
+
+    using Id_set = std::unordered_set<Id, Id_hash>;
+
+    struct Stats;
+
+    // Correctly parsed element, with its name interned.
+    struct Element
+    {
+        Id id;
+        Name name;
+        int nodes[3];
+        int node_count;
+    };
+
+    // Correct elements of the netlist.
+    struct Netlist
+    {
+        Name_pool names;
+        std::vector<Element> elements;
+        Node_table node_table;
+
+        // Adds the element, which id is known not to repeat.
+        void add_element(lexer::Parsed_line const& parsed)
+        {
+            Element element{ Id{ parsed.type, parsed.number },
+                             names.intern(parsed.name),
+                             { parsed.nodes[0], parsed.nodes[1],
+                               parsed.nodes[2] },
+                             parsed.node_count };
+            elements.push_back(element);
+            node_table.connect(parsed.nodes, parsed.node_count);
+        }
+
+        // Moves all elements and connections of the [other] netlist to this
+        // one.
+        void merge(Netlist& other)
+        {
+            std::vector<Name> other_to_this(other.names.size());
+            for(Name name = 0; name < other.names.size(); ++name)
+                other_to_this[name] = names.intern(other.names[name]);
+
+            elements.reserve(elements.size() + other.elements.size());
+            for(auto element : other.elements)
+            {
+                element.name = other_to_this[element.name];
+                elements.push_back(element);
+            }
+            node_table.merge(other.node_table);
+
+            other = Netlist{};
+        }
+    };
+
+    // Errors are printed to the stderr as they are reported if [print] is
+    // set, and kept for later if [keep] is set.
+    struct Error_log
+    {
+        bool print{ true };
+        bool keep{ false };
+        std::size_t count{ 0 };
+        std::vector<std::uint64_t> lines;
+        std::vector<std::uint64_t> text_offsets{ 0 };
+        std::string text;
+
+        void report(std::size_t line_no, std::string_view line);
+    };
+
+    // Identifies the version of the source file. If none of these changed,
+    // the file is assumed to be unchanged.
+    struct Source_stamp
+    {
+        std::uint64_t device;
+        std::uint64_t inode;
+        std::uint64_t size;
+        std::int64_t modification_seconds;
+        std::int64_t modification_nanoseconds;
+
+        bool operator==(Source_stamp const& other) const
+        {
+            return device == other.device && inode == other.inode
+                && size == other.size
+                && modification_seconds == other.modification_seconds
+                && modification_nanoseconds == other.modification_nanoseconds;
+        }
+    };
+
+    // Fills the stamp of the open file. Returns false if it is not a regular
+    // file (eg. a pipe), which can not be cached.
+    bool get_source_stamp(int fd, Source_stamp& stamp);
+
+    // Process the single input line. If line is empty it will do nothing,
+    // otherwise it updates the data structures. [masks] of the line from the
+    // scan::Line_scanner are used by the lexer if given.
+    bool process_input_line(std::string_view line,
+                            Id_set& used_ids,
+                            Netlist& netlist,
+                            scan::Masks const* masks = nullptr);
+
+    // Parses the whole input line by line. If [stats] are given, every step
+    // of every line is timed, which makes the parsing a bit slower.
+    Netlist parse_sequential(std::istream& input, Error_log& error_log,
+                             Stats* stats = nullptr);
+
+    // Parses the text which is already in memory.
+    Netlist parse_text(std::string_view text, Error_log& error_log);
+
+    // Parses the whole input of the file using [thread_count] threads. See
+    // netlist.cc for the details. If [stats] are given, the phases of every
+    // round are timed.
+    Netlist parse_parallel(int fd, std::size_t thread_count,
+                           Error_log& error_log, Stats* stats = nullptr);
+}
+
+#endif
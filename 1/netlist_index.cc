@@ -0,0 +1,554 @@
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <type_traits>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "netlist_index.h"
+#include "stats.h"
+
+using obwody::Array_view;
+using obwody::element_priority;
+using obwody::Error_log;
+using obwody::Id;
+using obwody::image_alignment;
+using obwody::Image_header;
+using obwody::Mapped_file;
+using obwody::Name;
+using obwody::Netlist;
+using obwody::Netlist_image;
+using obwody::Netlist_index;
+using obwody::Node_table;
+using obwody::Phase_timer;
+using obwody::Source_stamp;
+using obwody::Stats;
+
+namespace
+{
+    // Sort key of the single element: priority of its type in the bits
+    // 61-63, its number (which has at most 9 digits, so fits in 30 bits) in
+    // the bits 31-60 and its index in Netlist::elements in the lower 31 bits.
+    // Ids do not repeat, so the elements are sorted by the top 33 bits alone.
+    using Sort_key = std::uint64_t;
+    constexpr int sort_key_element_bits{ 31 };
+    constexpr int sort_key_number_bits{ 30 };
+
+    Sort_key make_sort_key(Id id, std::uint32_t element)
+    {
+        return (Sort_key(element_priority(id.type()))
+                << (sort_key_number_bits + sort_key_element_bits))
+            | (Sort_key(id.number()) << sort_key_element_bits)
+            | element;
+    }
+
+    std::uint32_t sort_key_element(Sort_key key)
+    {
+        return key & ((Sort_key{ 1 } << sort_key_element_bits) - 1);
+    }
+
+    int sort_key_priority(Sort_key key)
+    {
+        return key >> (sort_key_number_bits + sort_key_element_bits);
+    }
+
+    // LSD radix sort of the keys by their top 33 bits, one byte at a time.
+    // Bytes which are the same in all keys are skipped.
+    void radix_sort(std::vector<Sort_key>& keys)
+    {
+        constexpr int first_byte{ sort_key_element_bits / 8 };
+        constexpr int bytes{ 8 - first_byte };
+        std::vector<std::size_t> counts(bytes * 256);
+        for(auto key : keys)
+            for(int i = 0; i < bytes; ++i)
+                counts[i * 256 + ((key >> (8 * (first_byte + i))) & 0xff)]++;
+
+        std::vector<Sort_key> buffer(keys.size());
+        for(int i = 0; i < bytes; ++i)
+        {
+            auto* byte_counts = counts.data() + i * 256;
+            if(std::any_of(byte_counts, byte_counts + 256,
+                           [&](auto count) { return count == keys.size(); }))
+            {
+                continue;
+            }
+
+            std::size_t offset{ 0 };
+            for(int digit = 0; digit < 256; ++digit)
+            {
+                auto count = byte_counts[digit];
+                byte_counts[digit] = offset;
+                offset += count;
+            }
+
+            int shift = 8 * (first_byte + i);
+            for(auto key : keys)
+                buffer[byte_counts[(key >> shift) & 0xff]++] = key;
+            keys.swap(buffer);
+        }
+    }
+
+    // Appends arrays to the image, aligning each of them.
+    struct Image_builder
+    {
+        std::vector<char> bytes;
+
+        template<typename T>
+        void append(T const* data, std::size_t count)
+        {
+            bytes.resize((bytes.size() + image_alignment - 1)
+                         / image_alignment * image_alignment);
+            auto const* first = reinterpret_cast<char const*>(data);
+            bytes.insert(bytes.end(), first, first + count * sizeof(T));
+        }
+
+        template<typename T>
+        void append(std::vector<T> const& data)
+        {
+            append(data.data(), data.size());
+        }
+    };
+
+    // Checks that the offsets start at 0, never decrease and end at [end].
+    bool valid_offsets(Array_view<std::uint64_t> offsets, std::uint64_t end)
+    {
+        if(offsets[0] != 0 || offsets[offsets.size - 1] != end)
+            return false;
+        for(std::size_t i = 1; i < offsets.size; ++i)
+            if(offsets[i] < offsets[i - 1])
+                return false;
+        return true;
+    }
+
+    // Checks that every value is a correct position in an array of the
+    // [bound] size.
+    template<typename T>
+    bool all_below(Array_view<T> values, std::uint64_t bound)
+    {
+        for(auto value : values)
+            if(value >= bound)
+                return false;
+        return true;
+    }
+}
+
+// All elements are sorted at once, after which every group (elements of
+// the same name and type) comes out sorted, and groups are ordered by
+// their first elements, as required.
+std::vector<char> obwody::build_image(Netlist& netlist,
+                                      Error_log const& errors,
+                                      Source_stamp const& source,
+                                      Stats* stats)
+{
+    auto const& elements = netlist.elements;
+    auto& node_table = netlist.node_table;
+
+    // Node 0 always exists in the network.
+    node_table.add_node(0);
+
+    Phase_timer timer{ stats, Stats::sort };
+    std::vector<Sort_key> keys;
+    keys.reserve(elements.size());
+    for(std::uint32_t i = 0; i < elements.size(); ++i)
+        keys.push_back(make_sort_key(elements[i].id, i));
+    radix_sort(keys);
+    timer.switch_to(Stats::group);
+
+    // Number the groups in the order of their first elements and compute
+    // where in the output every group starts.
+    auto group_index = [&](Sort_key key) {
+        return std::size_t{ elements[sort_key_element(key)].name }
+            * type_count + sort_key_priority(key);
+    };
+    constexpr auto no_group = std::numeric_limits<std::uint32_t>::max();
+    std::vector<std::uint32_t> group_of(netlist.names.size() * type_count,
+                                        no_group);
+    std::vector<std::uint64_t> group_offsets;
+    std::vector<Name> group_names;
+    for(auto key : keys)
+    {
+        auto& group = group_of[group_index(key)];
+        if(group == no_group)
+        {
+            group = group_offsets.size();
+            group_offsets.push_back(0);
+            group_names.push_back(elements[sort_key_element(key)].name);
+        }
+        group_offsets[group]++;
+    }
+    counts_to_offsets(group_offsets);
+
+    // Place the elements group after group, keeping the order in the
+    // group.
+    std::vector<std::uint32_t> element_at(elements.size());
+    std::vector<Id> ids(elements.size());
+    {
+        std::vector<std::uint64_t> group_end(group_offsets);
+        for(auto key : keys)
+        {
+            auto position = group_end[group_of[group_index(key)]]++;
+            element_at[position] = sort_key_element(key);
+            ids[position] = elements[sort_key_element(key)].id;
+        }
+    }
+    keys = std::vector<Sort_key>{};
+    group_of = std::vector<std::uint32_t>{};
+    timer.switch_to(Stats::nodes);
+
+    // Nodes in the increasing order, with their components and incident
+    // elements.
+    auto indices = node_table.indices_in_order();
+    std::vector<std::uint32_t> position_of_index(indices.size());
+    std::vector<int> node_numbers(indices.size());
+    std::vector<std::uint32_t> node_components(indices.size());
+    std::vector<std::uint64_t> node_offsets(indices.size());
+    {
+        std::vector<std::uint32_t> label_of_root(indices.size(),
+                                                 Node_table::no_index);
+        for(std::uint32_t position = 0; position < indices.size();
+            ++position)
+        {
+            auto index = indices[position];
+            position_of_index[index] = position;
+            node_numbers[position] = node_table.node(index);
+            node_offsets[position] = node_table.connection_count(index);
+
+            auto& label = label_of_root[node_table.find(index)];
+            if(label == Node_table::no_index)
+                label = position;
+            node_components[position] = label;
+        }
+    }
+    counts_to_offsets(node_offsets);
+
+    std::vector<std::uint32_t> node_elements(node_offsets.back());
+    {
+        // Going in the output order, elements of every node come out
+        // sorted.
+        std::vector<std::uint64_t> node_end(node_offsets);
+        for(std::uint32_t position = 0; position < elements.size();
+            ++position)
+        {
+            auto const& element = elements[element_at[position]];
+            for(int i = 0; i < element.node_count; ++i)
+            {
+                auto index = node_table.find_index(element.nodes[i]);
+                node_elements[node_end[position_of_index[index]]++]
+                    = position;
+            }
+        }
+    }
+
+    timer.switch_to(Stats::index);
+
+    // Nodes of every element, which come out sorted because the
+    // element's nodes are.
+    std::vector<std::uint64_t> element_offsets;
+    std::vector<std::uint32_t> element_nodes;
+    element_offsets.reserve(elements.size() + 1);
+    element_nodes.reserve(node_elements.size());
+    for(auto element_index : element_at)
+    {
+        auto const& element = elements[element_index];
+        element_offsets.push_back(element_nodes.size());
+        for(int i = 0; i < element.node_count; ++i)
+        {
+            auto index = node_table.find_index(element.nodes[i]);
+            element_nodes.push_back(position_of_index[index]);
+        }
+    }
+    element_offsets.push_back(element_nodes.size());
+
+    auto name_count = netlist.names.size();
+    std::vector<std::uint64_t> name_element_offsets(name_count);
+    for(auto element_index : element_at)
+        name_element_offsets[elements[element_index].name]++;
+    counts_to_offsets(name_element_offsets);
+
+    std::vector<std::uint32_t> name_elements(elements.size());
+    {
+        std::vector<std::uint64_t> name_end(name_element_offsets);
+        for(std::uint32_t position = 0; position < elements.size();
+            ++position)
+        {
+            auto name = elements[element_at[position]].name;
+            name_elements[name_end[name]++] = position;
+        }
+    }
+
+    std::vector<std::uint64_t> name_offsets{ 0 };
+    std::string name_chars;
+    for(Name name = 0; name < name_count; ++name)
+    {
+        name_chars.append(netlist.names[name]);
+        name_offsets.push_back(name_chars.size());
+    }
+
+    std::vector<Name> sorted_names(name_count);
+    for(Name name = 0; name < name_count; ++name)
+        sorted_names[name] = name;
+    std::sort(sorted_names.begin(), sorted_names.end(),
+              [&](Name lhs, Name rhs) {
+                  return netlist.names[lhs] < netlist.names[rhs];
+              });
+
+    std::vector<std::uint32_t> sorted_elements(elements.size());
+    for(std::uint32_t position = 0; position < elements.size();
+        ++position)
+    {
+        sorted_elements[position] = position;
+    }
+    std::sort(sorted_elements.begin(), sorted_elements.end(),
+              [&](std::uint32_t lhs, std::uint32_t rhs) {
+                  return ids[lhs].key < ids[rhs].key;
+              });
+
+    if(stats != nullptr)
+    {
+        stats->element_count += ids.size();
+        stats->group_count += group_names.size();
+        stats->node_count += node_numbers.size();
+    }
+
+    Image_header header{};
+    std::memcpy(header.magic, image_magic, sizeof(image_magic));
+    header.version = image_version;
+    header.source = source;
+    header.name_count = name_count;
+    header.name_bytes = name_chars.size();
+    header.group_count = group_names.size();
+    header.element_count = ids.size();
+    header.node_count = node_numbers.size();
+    header.incidence_count = node_elements.size();
+    header.error_count = errors.lines.size();
+    header.error_bytes = errors.text.size();
+
+    Image_builder builder;
+    builder.append(&header, 1);
+    builder.append(name_offsets);
+    builder.append(name_chars.data(), name_chars.size());
+    builder.append(group_offsets);
+    builder.append(group_names);
+    builder.append(ids);
+    builder.append(node_numbers);
+    builder.append(node_components);
+    builder.append(node_offsets);
+    builder.append(node_elements);
+    builder.append(element_offsets);
+    builder.append(element_nodes);
+    builder.append(name_element_offsets);
+    builder.append(name_elements);
+    builder.append(sorted_names);
+    builder.append(sorted_elements);
+    builder.append(errors.lines);
+    builder.append(errors.text_offsets);
+    builder.append(errors.text.data(), errors.text.size());
+    return std::move(builder.bytes);
+}
+
+bool Netlist_image::open(char const* data, std::size_t size)
+{
+    std::size_t used{ 0 };
+    auto take = [&](auto& view, std::uint64_t count) {
+        using T = std::remove_reference_t<decltype(view[0])>;
+        used = (used + image_alignment - 1) / image_alignment
+            * image_alignment;
+        if(used > size || count > (size - used) / sizeof(T))
+            return false;
+        view.data = reinterpret_cast<T const*>(data + used);
+        view.size = count;
+        used += count * sizeof(T);
+        return true;
+    };
+
+    if(size < sizeof(Image_header))
+        return false;
+    header = reinterpret_cast<Image_header const*>(data);
+    used = sizeof(Image_header);
+    if(std::memcmp(header->magic, image_magic, sizeof(image_magic)) != 0
+       || header->version != image_version)
+    {
+        return false;
+    }
+
+    // Every array has at least as many bytes as elements, so none of the
+    // counts of a correct image is larger than the image, and adding one to
+    // them can not overflow. Names and elements are referred to by 32-bit
+    // positions.
+    for(auto count : { header->name_count, header->name_bytes,
+                       header->group_count, header->element_count,
+                       header->node_count, header->incidence_count,
+                       header->error_count, header->error_bytes })
+    {
+        if(count > size)
+            return false;
+    }
+    auto max_position = std::numeric_limits<std::uint32_t>::max();
+    if(header->name_count > max_position
+       || header->element_count > max_position
+       || header->node_count > max_position)
+    {
+        return false;
+    }
+
+    bool complete = take(name_offsets, header->name_count + 1)
+        && take(name_chars, header->name_bytes)
+        && take(group_offsets, header->group_count + 1)
+        && take(group_names, header->group_count)
+        && take(ids, header->element_count)
+        && take(node_numbers, header->node_count)
+        && take(node_components, header->node_count)
+        && take(node_offsets, header->node_count + 1)
+        && take(node_elements, header->incidence_count)
+        && take(element_offsets, header->element_count + 1)
+        && take(element_nodes, header->incidence_count)
+        && take(name_element_offsets, header->name_count + 1)
+        && take(name_elements, header->element_count)
+        && take(sorted_names, header->name_count)
+        && take(sorted_elements, header->element_count)
+        && take(error_lines, header->error_count)
+        && take(error_offsets, header->error_count + 1)
+        && take(error_chars, header->error_bytes);
+    if(!complete)
+        return false;
+
+    // The arrays are used as they are, so every offset and position in them
+    // is checked not to point outside of the image.
+    return valid_offsets(name_offsets, header->name_bytes)
+        && valid_offsets(group_offsets, header->element_count)
+        && all_below(group_names, header->name_count)
+        && all_below(node_components, header->node_count)
+        && valid_offsets(node_offsets, header->incidence_count)
+        && all_below(node_elements, header->element_count)
+        && valid_offsets(element_offsets, header->incidence_count)
+        && all_below(element_nodes, header->node_count)
+        && valid_offsets(name_element_offsets, header->element_count)
+        && all_below(name_elements, header->element_count)
+        && all_below(sorted_names, header->name_count)
+        && all_below(sorted_elements, header->element_count)
+        && valid_offsets(error_offsets, header->error_bytes);
+}
+
+bool obwody::write_image_file(std::string const& path,
+                              char const* data,
+                              std::size_t size)
+{
+    // The name is unique, so the processes (and threads) writing the same
+    // file at once do not write over each other's temporary files.
+    static std::atomic<unsigned long> temporary_count{ 0 };
+    auto temporary_path = path + ".tmp" + std::to_string(getpid()) + "."
+        + std::to_string(temporary_count.fetch_add(1));
+    std::FILE* file = std::fopen(temporary_path.c_str(), "wb");
+    if(file == nullptr)
+        return false;
+
+    bool written = std::fwrite(data, 1, size, file) == size;
+    written = std::fclose(file) == 0 && written;
+    if(!written || std::rename(temporary_path.c_str(), path.c_str()) != 0)
+    {
+        std::remove(temporary_path.c_str());
+        return false;
+    }
+    return true;
+}
+
+Mapped_file::~Mapped_file()
+{
+    if(mapping != nullptr)
+        munmap(mapping, length);
+}
+
+bool Mapped_file::open(char const* path)
+{
+    int fd = ::open(path, O_RDONLY);
+    if(fd < 0)
+        return false;
+
+    struct stat file_stat;
+    if(fstat(fd, &file_stat) == 0 && file_stat.st_size > 0)
+    {
+        length = static_cast<std::size_t>(file_stat.st_size);
+        mapping = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+        if(mapping == MAP_FAILED)
+            mapping = nullptr;
+    }
+    close(fd);
+    return mapping != nullptr;
+}
+
+Netlist_index::Netlist_index(Netlist& netlist,
+                             Error_log const& errors,
+                             Source_stamp const& source,
+                             Stats* stats)
+    : bytes{ build_image(netlist, errors, source, stats) }
+{
+    view.open(bytes.data(), bytes.size());
+}
+
+bool Netlist_index::load(char const* path)
+{
+    auto mapped = std::make_unique<Mapped_file>();
+    Netlist_image mapped_view;
+    if(!mapped->open(path) || !mapped_view.open(mapped->data(), mapped->size()))
+        return false;
+
+    bytes = std::vector<char>{};
+    file = std::move(mapped);
+    view = mapped_view;
+    return true;
+}
+
+bool Netlist_index::save(std::string const& path) const
+{
+    auto const* data = reinterpret_cast<char const*>(view.header);
+    auto const* end = view.error_chars.end();
+    return write_image_file(path, data, end - data);
+}
+
+Netlist_index::Element_ref Netlist_index::find_element(Id id) const
+{
+    auto const& sorted = view.sorted_elements;
+    auto found = std::lower_bound(sorted.begin(), sorted.end(), id,
+                                  [&](std::uint32_t element, Id value) {
+                                      return view.ids[element].key < value.key;
+                                  });
+    if(found == sorted.end() || !(view.ids[*found] == id))
+        return not_found;
+    return *found;
+}
+
+Netlist_index::Node_ref Netlist_index::find_node(int node) const
+{
+    auto const& nodes = view.node_numbers;
+    auto found = std::lower_bound(nodes.begin(), nodes.end(), node);
+    if(found == nodes.end() || *found != node)
+        return not_found;
+    return found - nodes.begin();
+}
+
+Name Netlist_index::find_name(std::string_view name) const
+{
+    auto const& sorted = view.sorted_names;
+    auto found = std::lower_bound(sorted.begin(), sorted.end(), name,
+                                  [&](Name lhs, std::string_view value) {
+                                      return view.name(lhs) < value;
+                                  });
+    if(found == sorted.end() || view.name(*found) != name)
+        return not_found;
+    return *found;
+}
+
+Name Netlist_index::element_name(Element_ref element) const
+{
+    // The group containing the element is the last one starting at or
+    // before it.
+    auto const& offsets = view.group_offsets;
+    auto group = std::upper_bound(offsets.begin(), offsets.end(),
+                                  std::uint64_t{ element })
+        - offsets.begin() - 1;
+    return view.group_names[group];
+}
@@ -0,0 +1,297 @@
+#ifndef NETLIST_INDEX_H
+#define NETLIST_INDEX_H
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "netlist.h"
+
+// Compiled, read-only form of the netlist. It is used to print the report,
+// is what the cache file contains, and can be embedded in other programs to
+// query the netlist.
+namespace obwody
+{
+    // The compiled netlist: everything needed to print the report and answer
+    // the queries, laid out in flat arrays, so that it can be written to a
+    // file and mapped back as it is. The image is the header followed by the
+    // arrays listed in the Netlist_image, in the same order, each aligned to
+    // 8 bytes.
+    struct Image_header
+    {
+        char magic[8];
+        std::uint64_t version;
+        Source_stamp source;
+        std::uint64_t name_count;
+        std::uint64_t name_bytes;
+        std::uint64_t group_count;
+        std::uint64_t element_count;
+        std::uint64_t node_count;
+        std::uint64_t incidence_count;
+        std::uint64_t error_count;
+        std::uint64_t error_bytes;
+    };
+
+    constexpr char image_magic[8]{ "OBWODY" };
+    constexpr std::uint64_t image_version{ 2 };
+    constexpr std::size_t image_alignment{ 8 };
+
+    template<typename T>
+    struct Array_view
+    {
+        T const* data{ nullptr };
+        std::size_t size{ 0 };
+
+        T const& operator[](std::size_t index) const
+        {
+            return data[index];
+        }
+
+        T const* begin() const
+        {
+            return data;
+        }
+
+        T const* end() const
+        {
+            return data + size;
+        }
+    };
+
+    // View of the image, which does not own the memory. Elements are
+    // referred to by their positions in [ids], and nodes by their positions
+    // in [node_numbers].
+    struct Netlist_image
+    {
+        Image_header const* header{ nullptr };
+
+        // Names, stored one after another.
+        Array_view<std::uint64_t> name_offsets;
+        Array_view<char> name_chars;
+
+        // Groups of elements of the same name and type, in the output order.
+        // Ids of the group g are ids[group_offsets[g]..group_offsets[g + 1]).
+        Array_view<std::uint64_t> group_offsets;
+        Array_view<Name> group_names;
+        Array_view<Id> ids;
+
+        // Nodes in increasing order. Component of the node is the position of
+        // the smallest node connected to it. Elements connected to the node n
+        // are node_elements[node_offsets[n]..node_offsets[n + 1]).
+        Array_view<int> node_numbers;
+        Array_view<std::uint32_t> node_components;
+        Array_view<std::uint64_t> node_offsets;
+        Array_view<std::uint32_t> node_elements;
+
+        // Nodes of the element e are element_nodes[element_offsets[e]..
+        // element_offsets[e + 1]), in increasing order.
+        Array_view<std::uint64_t> element_offsets;
+        Array_view<std::uint32_t> element_nodes;
+
+        // Elements of the name n are name_elements[name_element_offsets[n]..
+        // name_element_offsets[n + 1]), in the output order.
+        Array_view<std::uint64_t> name_element_offsets;
+        Array_view<std::uint32_t> name_elements;
+
+        // Names in lexicographic order and elements in the order of their id
+        // keys, for the binary search.
+        Array_view<Name> sorted_names;
+        Array_view<std::uint32_t> sorted_elements;
+
+        // Parsing errors, in line order.
+        Array_view<std::uint64_t> error_lines;
+        Array_view<std::uint64_t> error_offsets;
+        Array_view<char> error_chars;
+
+        std::string_view name(Name name) const
+        {
+            return std::string_view{ name_chars.data + name_offsets[name],
+                                     name_offsets[name + 1]
+                                     - name_offsets[name] };
+        }
+
+        std::string_view error(std::size_t error) const
+        {
+            return std::string_view{ error_chars.data + error_offsets[error],
+                                     error_offsets[error + 1]
+                                     - error_offsets[error] };
+        }
+
+        // Points the view at the image. Returns false if the data is not a
+        // correct image.
+        bool open(char const* data, std::size_t size);
+    };
+
+    // Turns counts into offsets: every element becomes the sum of the
+    // previous ones, and the total is appended at the end.
+    template<typename T>
+    void counts_to_offsets(std::vector<T>& counts)
+    {
+        T offset{ 0 };
+        for(auto& count : counts)
+        {
+            auto current = count;
+            count = offset;
+            offset += current;
+        }
+        counts.push_back(offset);
+    }
+
+    // Compiles the netlist into the image. Node 0, which always exists in the
+    // network, is added to the netlist first. The phases are timed if the
+    // [stats] are given.
+    std::vector<char> build_image(Netlist& netlist,
+                                  Error_log const& errors,
+                                  Source_stamp const& source,
+                                  Stats* stats = nullptr);
+
+    // Writes the image to the file. It is first written to a temporary file
+    // which is then renamed, so that the other processes never see a partial
+    // image. Returns false on failure.
+    bool write_image_file(std::string const& path,
+                          char const* data,
+                          std::size_t size);
+
+    // Read-only memory mapping of the whole file.
+    class Mapped_file
+    {
+    public:
+        Mapped_file() = default;
+        ~Mapped_file();
+
+        Mapped_file(Mapped_file const&) = delete;
+        Mapped_file& operator=(Mapped_file const&) = delete;
+
+        // Returns false if the file can not be mapped.
+        bool open(char const* path);
+
+        char const* data() const
+        {
+            return static_cast<char const*>(mapping);
+        }
+
+        std::size_t size() const
+        {
+            return length;
+        }
+
+    private:
+        void* mapping{ nullptr };
+        std::size_t length{ 0 };
+    };
+
+    // Index of the netlist for the programs embedding the parser. It owns
+    // the image, either built from the parsed netlist or memory mapped from
+    // the file, and answers the queries from its arrays: lookups are binary
+    // searches and adjacency lists are contiguous ranges of the CSR arrays.
+    class Netlist_index
+    {
+    public:
+        // Position of the element; elements are kept in the output order.
+        using Element_ref = std::uint32_t;
+
+        // Position of the node; nodes are kept in increasing order.
+        using Node_ref = std::uint32_t;
+
+        // Returned by the lookups when nothing is found.
+        static constexpr std::uint32_t not_found{
+            std::numeric_limits<std::uint32_t>::max() };
+
+        Netlist_index() = default;
+
+        // Builds the index of the parsed netlist. Errors are in the index only
+        // if the log kept them.
+        Netlist_index(Netlist& netlist,
+                      Error_log const& errors,
+                      Source_stamp const& source = Source_stamp{},
+                      Stats* stats = nullptr);
+
+        // Maps the image file. Returns false if it can not be read or is not
+        // a correct image.
+        bool load(char const* path);
+
+        // Writes the image to the file, so that it can be loaded later.
+        bool save(std::string const& path) const;
+
+        Netlist_image const& image() const
+        {
+            return view;
+        }
+
+        std::size_t element_count() const
+        {
+            return view.ids.size;
+        }
+
+        std::size_t node_count() const
+        {
+            return view.node_numbers.size;
+        }
+
+        std::size_t name_count() const
+        {
+            return view.sorted_names.size;
+        }
+
+        // Lookups, all of them return [not_found] if there is no such item.
+        Element_ref find_element(Id id) const;
+        Node_ref find_node(int node) const;
+        Name find_name(std::string_view name) const;
+
+        Id element_id(Element_ref element) const
+        {
+            return view.ids[element];
+        }
+
+        Name element_name(Element_ref element) const;
+
+        int node_number(Node_ref node) const
+        {
+            return view.node_numbers[node];
+        }
+
+        std::string_view name(Name name) const
+        {
+            return view.name(name);
+        }
+
+        // Nodes the element is connected to, in increasing order.
+        Array_view<Node_ref> nodes_of_element(Element_ref element) const
+        {
+            return range(view.element_nodes, view.element_offsets, element);
+        }
+
+        // Elements connected to the node, in the output order.
+        Array_view<Element_ref> elements_of_node(Node_ref node) const
+        {
+            return range(view.node_elements, view.node_offsets, node);
+        }
+
+        // Elements of the given name, in the output order.
+        Array_view<Element_ref> elements_of_name(Name name) const
+        {
+            return range(view.name_elements, view.name_element_offsets, name);
+        }
+
+    private:
+        static Array_view<std::uint32_t> range(
+            Array_view<std::uint32_t> values,
+            Array_view<std::uint64_t> offsets,
+            std::size_t index)
+        {
+            return Array_view<std::uint32_t>{
+                values.data + offsets[index],
+                offsets[index + 1] - offsets[index] };
+        }
+
+        std::vector<char> bytes;
+        std::unique_ptr<Mapped_file> file;
+        Netlist_image view;
+    };
+}
+
+#endif
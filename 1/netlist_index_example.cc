@@ -0,0 +1,111 @@
+// Example of embedding the netlist parser in another program: the netlist is
+// parsed, indexed and queried, then the index is saved, loaded back and
+// queried again. The results for _schemat.in are checked with asserts.
+//
+// Usage: ./netlist_index_example [netlist file] [index file]
+
+#include <cassert>
+#include <fstream>
+#include <iostream>
+#include <string>
+
+#include "netlist.h"
+#include "netlist_index.h"
+
+namespace
+{
+    void print_element(obwody::Netlist_index const& index,
+                       obwody::Netlist_index::Element_ref element)
+    {
+        auto id = index.element_id(element);
+        std::cout << id.type() << id.number() << ' '
+                  << index.name(index.element_name(element)) << ':';
+        for(auto node : index.nodes_of_element(element))
+            std::cout << ' ' << index.node_number(node);
+        std::cout << '\n';
+    }
+
+    // Checks the queries against the contents of _schemat.in.
+    void check_schemat(obwody::Netlist_index const& index)
+    {
+        using obwody::Id;
+        using obwody::Netlist_index;
+
+        assert(index.element_count() == 11);
+        assert(index.node_count() == 8);
+        assert(index.find_element(Id{ 'R', 1 }) != Netlist_index::not_found);
+        assert(index.find_element(Id{ 'R', 5 }) == Netlist_index::not_found);
+        assert(index.find_element(Id{ 'C', 3 }) == Netlist_index::not_found);
+        assert(index.find_node(2) == Netlist_index::not_found);
+
+        auto transistor = index.find_element(Id{ 'T', 2 });
+        assert(index.name(index.element_name(transistor)) == "BC107");
+        assert(index.nodes_of_element(transistor).size == 3);
+
+        auto name = index.find_name("47k/0,125W");
+        assert(name != Netlist_index::not_found);
+        assert(index.elements_of_name(name).size == 2);
+        assert(index.find_name("47k") == Netlist_index::not_found);
+
+        // Node 1 connects the source and the four resistors.
+        auto node = index.find_node(1);
+        assert(node != Netlist_index::not_found);
+        assert(index.elements_of_node(node).size == 5);
+        assert(index.elements_of_node(index.find_node(3)).size == 1);
+        assert(index.image().error_lines.size == 3);
+    }
+}
+
+int main(int argc, char** argv)
+{
+    std::string path{ argc > 1 ? argv[1] : "_schemat.in" };
+    std::string index_path{ argc > 2 ? argv[2] : "_schemat.index" };
+
+    std::ifstream input{ path };
+    if(!input)
+    {
+        std::cerr << "Could not open " << path << '\n';
+        return 1;
+    }
+
+    // Keep the errors, so that they are saved in the index too.
+    obwody::Error_log error_log;
+    error_log.keep = true;
+    auto netlist = obwody::parse_sequential(input, error_log);
+    obwody::Netlist_index index{ netlist, error_log };
+
+    std::cout << index.element_count() << " elements, " << index.node_count()
+              << " nodes, " << index.name_count() << " names\n";
+    using Node_ref = obwody::Netlist_index::Node_ref;
+    for(Node_ref node = 0; node < index.node_count(); ++node)
+    {
+        std::cout << "Node " << index.node_number(node) << ":\n";
+        for(auto element : index.elements_of_node(node))
+        {
+            std::cout << "    ";
+            print_element(index, element);
+        }
+    }
+
+    if(!index.save(index_path))
+    {
+        std::cerr << "Could not write the index file " << index_path << '\n';
+        return 1;
+    }
+
+    obwody::Netlist_index loaded;
+    if(!loaded.load(index_path.c_str()))
+    {
+        std::cerr << "Could not load the index file " << index_path << '\n';
+        return 1;
+    }
+    assert(loaded.element_count() == index.element_count());
+
+    if(path == "_schemat.in")
+    {
+        check_schemat(index);
+        check_schemat(loaded);
+        std::cout << "All checks passed\n";
+    }
+    return 0;
+}
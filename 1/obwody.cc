@@ -1,255 +1,301 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
 #include <iostream>
 #include <string>
-#include <regex>
-#include <unordered_set>
-#include <unordered_map>
+#include <thread>
+#include <vector>
+
+#include <unistd.h>
+
+#include "batch.h"
+#include "incremental.h"
+#include "netlist.h"
+#include "netlist_index.h"
+#include "report.h"
+#include "stats.h"
+#include "streaming.h"
+#include "subcircuit.h"
+
+using namespace obwody;
 
 namespace
 {
-    // The element Id is represented as a pair of a character and integer.
-    using Id = std::pair<char, int>;
-
-    std::ostream& operator<<(std::ostream& os,  Id const& id)
+    void print_usage(char const* program)
     {
-        os << id.first << id.second;
-        return os;
+        std::cerr << "Usage: " << program
+                  << " [-j threads] [--floating] [--stats] [--cache file]"
+                  << " [--incremental file] [--subckt]"
+                  << " [--memory-budget MB [--spill-dir dir]]"
+                  << " [--batch [--output-dir dir] path...]\n";
     }
 
-    template<typename T>
-    std::ostream& operator<<(std::ostream& os,  std::vector<T> const& v)
+    // Loads the file and then applies the edits read from the stdin, one per
+    // line:
+    //     a N text   inserts the text as the line N,
+    //     d N        removes the line N,
+    //     r N text   replaces the line N with the text,
+    //     .          ends the batch of edits and prints the changes.
+    // The changes of the loaded file are printed first, see
+    // Incremental_netlist::report_changes() for the format.
+    int run_incremental(char const* path)
     {
-        bool first_printed{ false };
-        for(auto const& value : v)
+        std::ifstream file{ path };
+        if(!file)
+        {
+            std::cerr << "Could not open " << path << '\n';
+            return 1;
+        }
+
+        Incremental_netlist netlist;
+        std::string line;
+        while(std::getline(file, line))
+            netlist.insert_line(netlist.line_count() + 1, line);
+
+        Buffered_writer output{ stdout };
+        netlist.report_changes(output);
+        output.flush();
+        std::fflush(stdout);
+
+        while(std::getline(std::cin, line))
         {
-            if(first_printed)
-                os << ", " << value;
-            else
+            if(line == ".")
             {
-                os << value;
-                first_printed = true;
+                netlist.report_changes(output);
+                output.flush();
+                std::fflush(stdout);
+                continue;
             }
+
+            // The text starts after the single space following the number.
+            char command = line.empty() ? '\0' : line[0];
+            char* end{ nullptr };
+            auto line_no = std::strtoull(line.c_str() + 1, &end, 10);
+            std::string_view text{ end };
+            if(!text.empty() && text[0] == ' ')
+                text.remove_prefix(1);
+
+            bool applied{ false };
+            if(command == 'a')
+                applied = netlist.insert_line(line_no, text);
+            else if(command == 'd' && text.empty())
+                applied = netlist.remove_line(line_no);
+            else if(command == 'r')
+                applied = netlist.replace_line(line_no, text);
+
+            if(!applied)
+                std::cerr << "Invalid edit: " << line << '\n';
         }
-        return os;
+        return 0;
     }
-    // This regex will match any correct lines. The matching groups are
-    // (starting from 1):
-    // 1 - If this group is empty, this means the element is a transistor.
-    //     Based on wheter or not this one is empty, you check the following
-    //     groups to get the result.
-    // If the element is transistor:
-    //     5 - The Id of the element (type letter (D, R, C or E) + the number);
-    //     6 - The type of the element;
-    //     7, 8, 9 - Numbers of nodes for which the element is connected to.
-    // Else:
-    //     1 - The Id of the element (type letter (D, R, C or E) + the number);
-    //     2 - The type of the element;
-    //     3, 4 - Numbers of nodes for which the element is connected to.
-    // This is a single text line, C++ preprocessor connects these strings.
-    constexpr auto correct_line_regexp{
-        "^\\s*"
-        "(?:([DRCE](?:0|[1-9][0-9]{0,8}))\\s+"
-        "((?:[A-Z]|[0-9])(?:[A-Za-z0-9]|,|-|\\/)*)\\s+"
-        "(0|[1-9][0-9]{0,8})\\s+"
-        "(0|[1-9][0-9]{0,8})|"
-        "(?:(T(?:0|[1-9][0-9]{0,8}))\\s+"
-        "((?:[A-Z]|[0-9])(?:[A-Za-z0-9]|,|-|\\/)*))\\s+"
-        "(0|[1-9][0-9]{0,8})\\s+"
-        "(0|[1-9][0-9]{0,8})\\s+"
-        "(0|[1-9][0-9]{0,8}))"
-        "\\s*$" };
-
-    // Defines the prority for the given type when sorting the lists of
-    // elements. The lower value, the higher proprity type has.
-    const std::unordered_map<char, int> element_priority{
-        { 'T', 1 }, { 'D', 2 }, { 'R', 3 }, { 'C', 4 }, { 'E', 5 } };
-
-    // All fucntions are marked inline, because g++ on -O2 optimization 
-    // will not try to inline fucntions unless it is explicitly marked so.
-    
-    // Compare two Ids. Ids are compared firstly based on type which is the
-    // first element of the pair. If types are same, then we compare the integer
-    // values.
-    inline bool compare_ids(Id lhs, Id rhs)
-    {
-        if(lhs.first == rhs.first)
-            return lhs.second <= rhs.second;
-        return element_priority.at(lhs.first) <= element_priority.at(rhs.first);
-    };
-
-    inline bool parse_input_line(std::string const& line, 
-        std::string &id, 
-        std::string &name, 
-        std::vector<int> &values)
-    {
-        std::smatch reg_match;
-        std::regex reg_expression{ correct_line_regexp };
-
-        // If line does not match the regex it is incorrect.
-        if(!std::regex_search(line, reg_match, reg_expression))
-            return false;
+}
 
-        if(reg_match[1] == "")
+int main(int argc, char** argv)
+{
+    auto start = std::chrono::steady_clock::now();
+
+    // Number of threads used for parsing, 0 means the sequential version.
+    std::size_t thread_count{ 0 };
+    bool report_floating{ false };
+
+    // Statistics of the run are printed to the stderr after the report.
+    bool print_stats{ false };
+    std::string cache_path;
+    char const* incremental_path{ nullptr };
+
+    // The input may have subcircuits, see subcircuit.h. It is parsed
+    // sequentially and not cached.
+    bool subcircuits{ false };
+
+    // With the memory budget set, the input is parsed sequentially and
+    // sorted through the temporary files, see streaming.h. It is not cached.
+    bool streaming{ false };
+    Streaming_options streaming_options;
+
+    // In the batch mode the other arguments are the files and directories
+    // to process.
+    bool batch{ false };
+    std::vector<std::string> batch_paths;
+    std::string output_dir;
+    for(int i = 1; i < argc; ++i)
+    {
+        if(std::strcmp(argv[i], "-j") == 0 && i + 1 < argc)
         {
-            // In this case the object is a transistor, and it has 3 ends.
-            id = reg_match[5];
-            name = reg_match[6];
-
-            values = std::vector<int> {
-                std::stoi(reg_match[7]),
-                std::stoi(reg_match[8]),
-                std::stoi(reg_match[9])
-            };
+            thread_count = std::strtoul(argv[++i], nullptr, 10);
+            if(thread_count == 0)
+                thread_count = std::max(1u, std::thread::hardware_concurrency());
+        }
+        else if(std::strcmp(argv[i], "--floating") == 0)
+        {
+            report_floating = true;
+        }
+        else if(std::strcmp(argv[i], "--stats") == 0)
+        {
+            print_stats = true;
+        }
+        else if(std::strcmp(argv[i], "--cache") == 0 && i + 1 < argc)
+        {
+            cache_path = argv[++i];
+        }
+        else if(std::strcmp(argv[i], "--incremental") == 0 && i + 1 < argc)
+        {
+            incremental_path = argv[++i];
+        }
+        else if(std::strcmp(argv[i], "--subckt") == 0)
+        {
+            subcircuits = true;
+        }
+        else if(std::strcmp(argv[i], "--memory-budget") == 0
+                && i + 1 < argc)
+        {
+            auto megabytes = std::strtoull(argv[++i], nullptr, 10);
+            if(megabytes == 0)
+            {
+                print_usage(argv[0]);
+                return 1;
+            }
+            streaming = true;
+            streaming_options.memory_budget = megabytes << 20;
+        }
+        else if(std::strcmp(argv[i], "--spill-dir") == 0 && i + 1 < argc)
+        {
+            streaming_options.spill_dir = argv[++i];
+        }
+        else if(std::strcmp(argv[i], "--batch") == 0)
+        {
+            batch = true;
+        }
+        else if(std::strcmp(argv[i], "--output-dir") == 0 && i + 1 < argc)
+        {
+            output_dir = argv[++i];
+        }
+        else if(batch && argv[i][0] != '-')
+        {
+            batch_paths.push_back(argv[i]);
         }
         else
         {
-            // Otherwise we must check the type by getting the first match
-            // group.
-            id = reg_match[1];
-            name = reg_match[2];
-
-            values = std::vector<int> {
-                std::stoi(reg_match[3]),
-                std::stoi(reg_match[4])
-            };
+            print_usage(argv[0]);
+            return 1;
         }
+    }
 
-        // If the element is transistor it can be connected to the same node
-        // twice, so we first make sure that all values are uniqe. Then if there
-        // is only one value it means that the all values are the same, so we
-        // return false.
-        std::sort(values.begin(), values.end());
-        auto last = std::unique(values.begin(), values.end());
-        values.erase(last, values.end());
-
-        if(values.size() == 1)
-            return false;
+    if(incremental_path != nullptr)
+        return run_incremental(incremental_path);
 
-        return true;
+    if(subcircuits)
+    {
+        Subcircuit_netlist netlist;
+        std::string line;
+        while(std::getline(std::cin, line))
+            netlist.add_line(line);
+        netlist.print_report(report_floating);
+        return 0;
     }
 
-    // Process the single input line. If line is empty it will do nothing,
-    // otherwise it updates the data structures
-    inline bool process_input_line(
-        std::string const& line,
-        std::unordered_set<std::string>& used_ids,
-        std::unordered_map<std::string, std::vector<Id>>& name_to_ids,
-        std::unordered_map<int, int>& node_to_connection_count)
+    if(batch)
     {
-        if(line == "")
-            return true;
-
-        std::string id;
-        std::string name;
-        std::vector<int> values;
-        if (!parse_input_line(line, id, name, values))
-            return false;
-
-        // If the second value of the pair returned by insert is false, this
-        // means the value were already there and we should return false.
-        bool insertion_result{ used_ids.insert(id).second };
-        if(!insertion_result)
-            return false;
-
-        name_to_ids[name].emplace_back(id[0], std::stoi(id.c_str() + 1));
+        Batch_options options;
+        options.thread_count = thread_count > 0
+            ? thread_count
+            : std::max(1u, std::thread::hardware_concurrency());
+        options.report_floating = report_floating;
+        options.output_dir = output_dir;
+        return run_batch(expand_batch_paths(batch_paths), options) ? 0 : 1;
+    }
 
-        // Increment connection count for each node.
-        for(auto i : values)
-            node_to_connection_count[i]++;
+    Stats collected_stats;
+    Stats* stats = print_stats ? &collected_stats : nullptr;
 
-        return true;
+    if(streaming)
+    {
+        streaming_options.report_floating = report_floating;
+        bool written;
+        {
+            Buffered_writer errors{ stderr };
+            Buffered_writer output{ stdout };
+            written = stream_report(std::cin, streaming_options, output,
+                                    errors, stats);
+        }
+        if(!written)
+            std::cerr << "Could not write the temporary files\n";
+        if(stats != nullptr)
+            stats->report(std::cerr, start);
+        return written ? 0 : 1;
     }
 
-    // Compute the output.
-    using result_type = std::vector<std::pair<std::string, std::vector<Id>>>;
-    inline result_type compute_elements_list(
-        std::unordered_map<std::string, std::vector<Id>> const& name_to_ids)
+    // The cache is used only if the input is a regular file, and it is valid
+    // only for the same version of that file.
+    Source_stamp source{};
+    bool use_cache = !cache_path.empty()
+        && get_source_stamp(STDIN_FILENO, source);
+    if(use_cache)
     {
-        result_type result;
-        result.reserve(name_to_ids.size());
-
-        for(auto name_ids_pair : name_to_ids)
+        Netlist_index cache;
+        bool loaded;
         {
-            std::unordered_map<char, std::vector<Id>> types;
-            for(auto& type : name_ids_pair.second)
-                types[type.first].emplace_back(std::move(type));
-
-            for(auto& type_vector : types)
+            Phase_timer timer{ stats, Stats::cache };
+            loaded = cache.load(cache_path.c_str())
+                && cache.image().header->source == source;
+        }
+        if(loaded)
+        {
+            {
+                Phase_timer timer{ stats, Stats::print };
+                print_report(cache.image(), true, report_floating);
+            }
+            if(stats != nullptr)
             {
-                result.emplace_back(name_ids_pair.first,
-                                    std::move(type_vector.second));
+                auto const* header = cache.image().header;
+                stats->element_count = header->element_count;
+                stats->error_count = header->error_count;
+                stats->group_count = header->group_count;
+                stats->node_count = header->node_count;
+                stats->report(std::cerr, start);
             }
+            return 0;
         }
-        return result;
     }
 
-    // Compute and print the output to the stdout.
-    inline void compute_and_print_elements_list(
-        std::unordered_map<std::string, std::vector<Id>> const& name_to_ids)
+    Error_log error_log;
+    error_log.keep = use_cache;
+    Netlist netlist;
+    if(thread_count > 0)
     {
-        auto result = compute_elements_list(name_to_ids);
-
-        for(auto& result_record : result)
-        {
-            std::sort(result_record.second.begin(),
-                      result_record.second.end(),
-                      compare_ids);
-        }
-
-        // Since every individual vector is sorted, and Ids does not repeat, we
-        // just have to compare first elements.
-        std::sort(result.begin(), result.end(),
-                  [](auto x, auto y) {
-                      return compare_ids(x.second[0], y.second[0]);
-                  });
-
-        for(auto key_value_pair : result)
-            std::cout << key_value_pair.second << ": " 
-                      << key_value_pair.first << '\n';
+        std::ios_base::sync_with_stdio(false);
+        netlist = parse_parallel(STDIN_FILENO, thread_count, error_log,
+                                 stats);
     }
-
-    // Given a note to number of connected elements map, checks if any element
-    // has less than two connected entities and if so, prints the warrning to
-    // the stderr.
-    inline void check_for_unconnected_nodes(
-        std::unordered_map<int, int> const& node_to_connection_count)
+    else
     {
-        std::vector<int> unconnected_nodes;
-        for(auto const& i : node_to_connection_count)
-            if(i.second < 2)
-                unconnected_nodes.emplace_back(i.first);
-
-        // If any unconnected node has been found print a warning to the stderr.
-        if(unconnected_nodes.size() > 0)
-        {
-            std::sort(unconnected_nodes.begin(), unconnected_nodes.end());
-            std::cerr << "Warning, unconnected node(s): "
-                      << unconnected_nodes << '\n';
-        }
+        netlist = parse_sequential(std::cin, error_log, stats);
     }
-}
 
-int main()
-{
-    std::unordered_set<std::string> used_ids;
-    std::unordered_map<std::string, std::vector<Id>> name_to_ids;
-    std::unordered_map<int, int> node_to_connection_count;
-
-    // Node 0 always exists in the network.
-    node_to_connection_count.insert({ 0, 0 });
+    if(stats != nullptr)
+    {
+        stats->error_count = error_log.count;
+        stats->record_netlist(netlist);
+    }
+    Netlist_index index{ netlist, error_log, source, stats };
+    netlist = Netlist{};
+    {
+        Phase_timer timer{ stats, Stats::print };
+        print_report(index.image(), false, report_floating);
+    }
 
-    std::string line;
-    for(std::size_t line_no{ 1 }; std::getline(std::cin, line); ++line_no)
+    if(use_cache)
     {
-        if(!process_input_line(line, used_ids,
-                               name_to_ids,
-                               node_to_connection_count))
+        Phase_timer timer{ stats, Stats::cache };
+        if(!index.save(cache_path))
         {
-            std::cerr << "Error in line " << line_no << ": " << line << '\n';
+            std::cerr << "Could not write the cache file " << cache_path
+                      << '\n';
         }
     }
 
-    compute_and_print_elements_list(name_to_ids);
-    check_for_unconnected_nodes(node_to_connection_count);
-
+    if(stats != nullptr)
+        stats->report(std::cerr, start);
     return 0;
 }
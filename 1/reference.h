@@ -0,0 +1,194 @@
+#ifndef REFERENCE_H
+#define REFERENCE_H
+
+#include <algorithm>
+#include <map>
+#include <regex>
+#include <set>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+// The way the first version of the program parsed the lines and built the
+// report: with the regular expression, ordered maps and a search of the
+// graph. It is slow, but simple enough to be obviously correct, so the
+// benchmarks check the results of the program against it.
+namespace reference
+{
+    // The regular expression used by the original parser. The matching groups
+    // are (starting from 1):
+    // 1 - If this group is empty, this means the element is a transistor.
+    // If the element is transistor:
+    //     5 - The Id of the element;
+    //     6 - The type of the element;
+    //     7, 8, 9 - Numbers of nodes for which the element is connected to.
+    // Else:
+    //     1 - The Id of the element;
+    //     2 - The type of the element;
+    //     3, 4 - Numbers of nodes for which the element is connected to.
+    constexpr auto correct_line_regexp{
+        "^\\s*"
+        "(?:([DRCE](?:0|[1-9][0-9]{0,8}))\\s+"
+        "((?:[A-Z]|[0-9])(?:[A-Za-z0-9]|,|-|\\/)*)\\s+"
+        "(0|[1-9][0-9]{0,8})\\s+"
+        "(0|[1-9][0-9]{0,8})|"
+        "(?:(T(?:0|[1-9][0-9]{0,8}))\\s+"
+        "((?:[A-Z]|[0-9])(?:[A-Za-z0-9]|,|-|\\/)*))\\s+"
+        "(0|[1-9][0-9]{0,8})\\s+"
+        "(0|[1-9][0-9]{0,8})\\s+"
+        "(0|[1-9][0-9]{0,8}))"
+        "\\s*$" };
+
+    // The original parsing function. The nodes are returned sorted and
+    // without duplicates.
+    inline bool regex_parse_line(std::string const& line,
+                                 std::regex const& reg_expression,
+                                 std::string& id,
+                                 std::string& name,
+                                 std::vector<int>& values)
+    {
+        std::smatch reg_match;
+
+        if(!std::regex_search(line, reg_match, reg_expression))
+            return false;
+
+        int first_group = reg_match[1] == "" ? 5 : 1;
+        int node_groups = reg_match[1] == "" ? 3 : 2;
+        id = reg_match[first_group];
+        name = reg_match[first_group + 1];
+        values.clear();
+        for(int i = 0; i < node_groups; ++i)
+            values.push_back(std::stoi(reg_match[first_group + 2 + i]));
+
+        std::sort(values.begin(), values.end());
+        auto last = std::unique(values.begin(), values.end());
+        values.erase(last, values.end());
+
+        return values.size() != 1;
+    }
+
+    // What the program prints to the stdout and to the stderr.
+    struct Report
+    {
+        std::string output;
+        std::string errors;
+    };
+
+    inline void append_list(std::string& text, std::vector<int> const& list)
+    {
+        for(std::size_t i = 0; i < list.size(); ++i)
+        {
+            if(i != 0)
+                text += ", ";
+            text += std::to_string(list[i]);
+        }
+        text += '\n';
+    }
+
+    inline Report make_report(std::string const& text, bool report_floating)
+    {
+        Report report;
+        std::regex const expression{ correct_line_regexp };
+        std::set<std::string> used_ids;
+
+        // Numbers of the elements of every group, by the name and the
+        // priority of the type.
+        std::map<std::pair<std::string, int>, std::vector<int>> groups;
+        std::map<int, int> connection_counts{ { 0, 0 } };
+        std::map<int, std::vector<int>> neighbours;
+
+        std::istringstream input{ text };
+        std::string line;
+        for(std::size_t line_no{ 1 }; std::getline(input, line); ++line_no)
+        {
+            if(line.empty())
+                continue;
+
+            std::string id, name;
+            std::vector<int> nodes;
+            if(!regex_parse_line(line, expression, id, name, nodes)
+               || !used_ids.insert(id).second)
+            {
+                report.errors += "Error in line " + std::to_string(line_no)
+                    + ": " + line + '\n';
+                continue;
+            }
+
+            int priority = std::string_view{ "TDRCE" }.find(id[0]);
+            groups[{ name, priority }].push_back(std::stoi(id.substr(1)));
+            for(auto node : nodes)
+            {
+                connection_counts[node]++;
+                neighbours[node].push_back(nodes[0]);
+                neighbours[nodes[0]].push_back(node);
+            }
+        }
+
+        // Groups are ordered by their first elements.
+        std::vector<std::pair<std::pair<int, int>,
+                              std::pair<std::string, int>>> group_order;
+        for(auto& [key, numbers] : groups)
+        {
+            std::sort(numbers.begin(), numbers.end());
+            group_order.push_back({ { key.second, numbers[0] }, key });
+        }
+        std::sort(group_order.begin(), group_order.end());
+        for(auto const& [first, key] : group_order)
+        {
+            auto const& numbers = groups[key];
+            for(std::size_t i = 0; i < numbers.size(); ++i)
+            {
+                if(i != 0)
+                    report.output += ", ";
+                report.output += "TDRCE"[key.second];
+                report.output += std::to_string(numbers[i]);
+            }
+            report.output += ": " + key.first + '\n';
+        }
+
+        std::vector<int> unconnected_nodes;
+        for(auto const& [node, count] : connection_counts)
+        {
+            if(count < 2)
+                unconnected_nodes.push_back(node);
+        }
+        if(!unconnected_nodes.empty())
+        {
+            report.errors += "Warning, unconnected node(s): ";
+            append_list(report.errors, unconnected_nodes);
+        }
+        if(!report_floating)
+            return report;
+
+        // Components are searched from their smallest nodes, so they come
+        // out in the order of them.
+        std::set<int> visited;
+        for(auto const& [start, count] : connection_counts)
+        {
+            if(!visited.insert(start).second)
+                continue;
+
+            std::vector<int> component{ start };
+            for(std::size_t i = 0; i < component.size(); ++i)
+            {
+                for(auto next : neighbours[component[i]])
+                {
+                    if(visited.insert(next).second)
+                        component.push_back(next);
+                }
+            }
+            if(start == 0)
+                continue;
+
+            std::sort(component.begin(), component.end());
+            report.errors += "Warning, sub-circuit not connected to the "
+                             "ground: ";
+            append_list(report.errors, component);
+        }
+        return report;
+    }
+}
+
+#endif
@@ -0,0 +1,151 @@
+#include <vector>
+
+#include "report.h"
+
+using obwody::Buffered_writer;
+using obwody::Netlist_image;
+using obwody::Node_components;
+using obwody::Node_table;
+
+namespace
+{
+    // Groups the [count] nodes by the labels of their components, which are
+    // below the [count]. [label] and [number] give the label and the number
+    // of the node at the position.
+    template<typename Label, typename Number>
+    Node_components group_by_label(std::size_t count, Label label,
+                                   Number number)
+    {
+        Node_components components;
+        components.offsets.resize(count);
+        for(std::size_t position = 0; position < count; ++position)
+            components.offsets[label(position)]++;
+        obwody::counts_to_offsets(components.offsets);
+
+        components.nodes.resize(count);
+        std::vector<std::uint64_t> component_end(components.offsets);
+        for(std::size_t position = 0; position < count; ++position)
+            components.nodes[component_end[label(position)]++]
+                = number(position);
+        return components;
+    }
+}
+
+Node_components obwody::group_components(Netlist_image const& image)
+{
+    return group_by_label(
+        image.node_numbers.size,
+        [&](std::size_t node) { return image.node_components[node]; },
+        [&](std::size_t node) { return image.node_numbers[node]; });
+}
+
+Node_components obwody::group_components(
+    Node_table& table, std::vector<Node_table::Index> const& indices)
+{
+    std::vector<Node_table::Index> label_of_root(indices.size(),
+                                                 Node_table::no_index);
+    std::vector<Node_table::Index> labels(indices.size());
+    for(Node_table::Index position = 0; position < indices.size();
+        ++position)
+    {
+        auto& label = label_of_root[table.find(indices[position])];
+        if(label == Node_table::no_index)
+            label = position;
+        labels[position] = label;
+    }
+
+    return group_by_label(
+        indices.size(),
+        [&](std::size_t position) { return labels[position]; },
+        [&](std::size_t position) { return table.node(indices[position]); });
+}
+
+void obwody::write_floating_warnings(Node_components const& components,
+                                     Buffered_writer& errors)
+{
+    for(std::size_t component = 1;
+        component + 1 < components.offsets.size(); ++component)
+    {
+        auto begin = components.offsets[component];
+        auto end = components.offsets[component + 1];
+        if(begin == end)
+            continue;
+
+        write_node_warning(errors,
+                           "Warning, sub-circuit not connected to the ground",
+                           components.nodes.begin() + begin,
+                           components.nodes.begin() + end);
+    }
+}
+
+void obwody::print_groups(Netlist_image const& image,
+                          Buffered_writer& output)
+{
+    for(std::size_t group = 0; group + 1 < image.group_offsets.size;
+        ++group)
+    {
+        auto begin = image.group_offsets[group];
+        auto end = image.group_offsets[group + 1];
+        for(auto i = begin; i < end; ++i)
+        {
+            if(i != begin)
+                output.write(", ");
+            output.write(image.ids[i].type());
+            output.write_number(image.ids[i].number());
+        }
+
+        output.write(": ");
+        output.write(image.name(image.group_names[group]));
+        output.write('\n');
+    }
+}
+
+void obwody::print_report(Netlist_image const& image,
+                          bool print_errors,
+                          bool report_floating,
+                          Buffered_writer& output,
+                          Buffered_writer& errors)
+{
+    if(print_errors)
+    {
+        for(std::size_t i = 0; i < image.error_lines.size; ++i)
+        {
+            errors.write("Error in line ");
+            errors.write_number(image.error_lines[i]);
+            errors.write(": ");
+            errors.write(image.error(i));
+            errors.write('\n');
+        }
+    }
+
+    print_groups(image, output);
+
+    auto node_count = image.node_numbers.size;
+    std::vector<int> unconnected_nodes;
+    for(std::size_t node = 0; node < node_count; ++node)
+    {
+        if(image.node_offsets[node + 1] - image.node_offsets[node] < 2)
+            unconnected_nodes.push_back(image.node_numbers[node]);
+    }
+
+    // If any unconnected node has been found print a warning to the stderr.
+    if(unconnected_nodes.size() > 0)
+    {
+        write_node_warning(errors, "Warning, unconnected node(s)",
+                           unconnected_nodes.begin(),
+                           unconnected_nodes.end());
+    }
+
+    if(report_floating)
+        write_floating_warnings(group_components(image), errors);
+}
+
+void obwody::print_report(Netlist_image const& image,
+                          bool print_errors,
+                          bool report_floating)
+{
+    // The elements list is flushed first, as the output is destroyed first.
+    Buffered_writer errors{ stderr };
+    Buffered_writer output{ stdout };
+    print_report(image, print_errors, report_floating, output, errors);
+}
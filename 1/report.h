@@ -0,0 +1,173 @@
+#ifndef REPORT_H
+#define REPORT_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "netlist_index.h"
+
+// Printing of the report of the compiled netlist.
+namespace obwody
+{
+    // Writes to the file, or appends to the string, through a large buffer,
+    // formatting the numbers by hand.
+    class Buffered_writer
+    {
+    public:
+        explicit Buffered_writer(std::FILE* file_) : file{ file_ }
+        {
+        }
+
+        explicit Buffered_writer(std::string& text_) : text{ &text_ }
+        {
+        }
+
+        ~Buffered_writer()
+        {
+            flush();
+        }
+
+        Buffered_writer(Buffered_writer const&) = delete;
+        Buffered_writer& operator=(Buffered_writer const&) = delete;
+
+        void write(std::string_view text)
+        {
+            if(used + text.size() > sizeof(buffer))
+            {
+                flush();
+                if(text.size() > sizeof(buffer))
+                {
+                    put(text.data(), text.size());
+                    return;
+                }
+            }
+            std::memcpy(buffer + used, text.data(), text.size());
+            used += text.size();
+        }
+
+        void write(char c)
+        {
+            if(used == sizeof(buffer))
+                flush();
+            buffer[used++] = c;
+        }
+
+        void write_number(std::uint64_t number)
+        {
+            char digits[20];
+            int length{ 0 };
+            do
+            {
+                digits[length++] = '0' + number % 10;
+                number /= 10;
+            } while(number != 0);
+
+            if(used + length > sizeof(buffer))
+                flush();
+            while(length > 0)
+                buffer[used++] = digits[--length];
+        }
+
+        void flush()
+        {
+            put(buffer, used);
+            used = 0;
+        }
+
+    private:
+        void put(char const* data, std::size_t size)
+        {
+            if(text != nullptr)
+                text->append(data, size);
+            else
+                std::fwrite(data, 1, size, file);
+        }
+
+        std::FILE* file{ nullptr };
+        std::string* text{ nullptr };
+        char buffer[1 << 16];
+        std::size_t used{ 0 };
+    };
+
+    // Writes the numbers separated with commas.
+    template<typename Iterator>
+    void write_list(Buffered_writer& writer, Iterator begin, Iterator end)
+    {
+        for(auto i = begin; i != end; ++i)
+        {
+            if(i != begin)
+                writer.write(", ");
+            writer.write_number(*i);
+        }
+    }
+
+    // Writes the warning about the nodes in a line, with the name of the
+    // sub-circuit definition they are in, if it is given.
+    template<typename Iterator>
+    void write_node_warning(Buffered_writer& errors,
+                            std::string_view what,
+                            Iterator begin,
+                            Iterator end,
+                            std::string_view definition = {})
+    {
+        errors.write(what);
+        if(!definition.empty())
+        {
+            errors.write(" in ");
+            errors.write(definition);
+        }
+        errors.write(": ");
+        write_list(errors, begin, end);
+        errors.write('\n');
+    }
+
+    // Nodes grouped by their connected components. Components are labeled
+    // with the positions of their smallest nodes, so they come out ordered
+    // by them. Nodes of the component c, in increasing order, are
+    // nodes[offsets[c]..offsets[c + 1]); the other labels have no nodes.
+    struct Node_components
+    {
+        std::vector<std::uint64_t> offsets;
+        std::vector<int> nodes;
+    };
+
+    // Groups the nodes of the image.
+    Node_components group_components(Netlist_image const& image);
+
+    // Groups the nodes of the table, whose [indices] are in increasing node
+    // order.
+    Node_components group_components(
+        Node_table& table, std::vector<Node_table::Index> const& indices);
+
+    // Writes the warnings about the components, except the one of node 0,
+    // which is the ground.
+    void write_floating_warnings(Node_components const& components,
+                                 Buffered_writer& errors);
+
+    // Prints the elements list: every group of elements of the same name and
+    // type in a line.
+    void print_groups(Netlist_image const& image, Buffered_writer& output);
+
+    // Prints the report: errors (only if [print_errors] is set, because when
+    // the text is parsed they are printed right away), the elements list to
+    // the [output], and the warnings about unconnected nodes and, if
+    // [report_floating] is set, sub-circuits not connected to the ground.
+    // Everything except the elements list goes to the [errors].
+    void print_report(Netlist_image const& image,
+                      bool print_errors,
+                      bool report_floating,
+                      Buffered_writer& output,
+                      Buffered_writer& errors);
+
+    // Prints the report to the stdout and stderr.
+    void print_report(Netlist_image const& image,
+                      bool print_errors,
+                      bool report_floating);
+}
+
+#endif
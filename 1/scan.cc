@@ -0,0 +1,310 @@
+#include <algorithm>
+#include <cstring>
+#include <initializer_list>
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+#include "scan.h"
+
+namespace
+{
+    using scan::Masks;
+    using scan::mask_bits;
+
+    char const* find_newline_scalar(char const* begin, char const* end)
+    {
+        auto const* found = static_cast<char const*>(
+            std::memchr(begin, '\n', end - begin));
+        return found != nullptr ? found : end;
+    }
+
+    // Runs the kernel on every full block of the data, and on the copy of
+    // the last, partial one padded with zeros, which are in none of the
+    // classes.
+    template<typename F>
+    void classify_blocks(char const* data, std::size_t size, Masks* masks,
+                         F classify_block)
+    {
+        for(; size >= mask_bits; data += mask_bits, size -= mask_bits)
+            *masks++ = classify_block(data);
+        if(size > 0)
+        {
+            alignas(32) char last[mask_bits]{};
+            std::memcpy(last, data, size);
+            *masks = classify_block(last);
+        }
+    }
+
+    // The portable version checks the 8 bytes of a 64-bit word at once. The
+    // high bit of every byte of the result tells if the byte is in [low,
+    // high]; bytes above 127 are in no range.
+    constexpr std::uint64_t ones{ 0x0101010101010101 };
+    constexpr std::uint64_t high_bits{ 0x8080808080808080 };
+
+    std::uint64_t in_range_scalar(std::uint64_t word, unsigned low,
+                                  unsigned high)
+    {
+        auto ascii = word & ~high_bits;
+        auto at_least_low = ascii + (128 - low) * ones;
+        auto above_high = ascii + (127 - high) * ones;
+        return at_least_low & ~above_high & ~word & high_bits;
+    }
+
+    // Gathers the high bits of the bytes into the lowest 8 bits.
+    std::uint64_t to_bits_scalar(std::uint64_t flags)
+    {
+        return ((flags >> 7) * 0x0102040810204080) >> 56;
+    }
+
+    Masks classify_block_scalar(char const* data)
+    {
+        Masks masks{ 0, 0, 0, 0 };
+        for(std::size_t i = 0; i < mask_bits; i += 8)
+        {
+            std::uint64_t word;
+            std::memcpy(&word, data + i, sizeof(word));
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+            word = __builtin_bswap64(word);
+#endif
+            auto digits = in_range_scalar(word, '0', '9');
+            auto name_chars = digits | in_range_scalar(word, 'A', 'Z')
+                | in_range_scalar(word, 'a', 'z')
+                | in_range_scalar(word, ',', '-')
+                | in_range_scalar(word, '/', '/');
+            auto spaces = in_range_scalar(word, ' ', ' ')
+                | in_range_scalar(word, '\t', '\r');
+
+            masks.newlines |= to_bits_scalar(in_range_scalar(word, '\n', '\n'))
+                << i;
+            masks.spaces |= to_bits_scalar(spaces) << i;
+            masks.digits |= to_bits_scalar(digits) << i;
+            masks.name_chars |= to_bits_scalar(name_chars) << i;
+        }
+        return masks;
+    }
+
+    void classify_scalar(char const* data, std::size_t size, Masks* masks)
+    {
+        classify_blocks(data, size, masks, classify_block_scalar);
+    }
+
+#if defined(__x86_64__)
+    // SSE4.2: the classes are given as lists of ranges to pcmpestrm.
+    __attribute__((target("sse4.2")))
+    char const* find_newline_sse42(char const* begin, char const* end)
+    {
+        auto newline = _mm_set1_epi8('\n');
+        for(; end - begin >= 16; begin += 16)
+        {
+            auto block = _mm_loadu_si128(
+                reinterpret_cast<__m128i const*>(begin));
+            int found = _mm_movemask_epi8(_mm_cmpeq_epi8(block, newline));
+            if(found != 0)
+                return begin + __builtin_ctz(found);
+        }
+        return find_newline_scalar(begin, end);
+    }
+
+    template<int range_count>
+    __attribute__((target("sse4.2")))
+    std::uint64_t in_ranges_sse42(__m128i bytes, __m128i ranges)
+    {
+        auto found = _mm_cmpestrm(ranges, 2 * range_count, bytes, 16,
+                                  _SIDD_UBYTE_OPS | _SIDD_CMP_RANGES
+                                  | _SIDD_BIT_MASK);
+        return static_cast<std::uint64_t>(_mm_cvtsi128_si32(found) & 0xffff);
+    }
+
+    __attribute__((target("sse4.2")))
+    Masks classify_block_sse42(char const* data)
+    {
+        auto newline = _mm_set1_epi8('\n');
+        auto spaces = _mm_setr_epi8('\t', '\r', ' ', ' ',
+                                    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0);
+        auto digits = _mm_setr_epi8('0', '9',
+                                    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0);
+        auto name_chars = _mm_setr_epi8('0', '9', 'A', 'Z', 'a', 'z',
+                                        ',', '-', '/', '/',
+                                        0, 0, 0, 0, 0, 0);
+
+        Masks masks{ 0, 0, 0, 0 };
+        for(std::size_t i = 0; i < mask_bits; i += 16)
+        {
+            auto bytes = _mm_loadu_si128(
+                reinterpret_cast<__m128i const*>(data + i));
+            auto newlines = static_cast<std::uint32_t>(
+                _mm_movemask_epi8(_mm_cmpeq_epi8(bytes, newline)));
+            masks.newlines |= std::uint64_t{ newlines } << i;
+            masks.spaces |= in_ranges_sse42<2>(bytes, spaces) << i;
+            masks.digits |= in_ranges_sse42<1>(bytes, digits) << i;
+            masks.name_chars |= in_ranges_sse42<5>(bytes, name_chars) << i;
+        }
+        return masks;
+    }
+
+    __attribute__((target("sse4.2")))
+    void classify_sse42(char const* data, std::size_t size, Masks* masks)
+    {
+        classify_blocks(data, size, masks, classify_block_sse42);
+    }
+
+    // AVX2: a byte is in the range [low, low + width] if it is there after
+    // subtracting [low], as an unsigned number.
+    __attribute__((target("avx2")))
+    __m256i in_range_avx2(__m256i bytes, char low, char width)
+    {
+        auto shifted = _mm256_sub_epi8(bytes, _mm256_set1_epi8(low));
+        auto limit = _mm256_set1_epi8(width);
+        return _mm256_cmpeq_epi8(_mm256_min_epu8(shifted, limit), shifted);
+    }
+
+    __attribute__((target("avx2")))
+    std::uint64_t to_bits(__m256i mask)
+    {
+        return static_cast<std::uint32_t>(_mm256_movemask_epi8(mask));
+    }
+
+    __attribute__((target("avx2")))
+    char const* find_newline_avx2(char const* begin, char const* end)
+    {
+        auto newline = _mm256_set1_epi8('\n');
+        for(; end - begin >= 32; begin += 32)
+        {
+            auto block = _mm256_loadu_si256(
+                reinterpret_cast<__m256i const*>(begin));
+            auto found = to_bits(_mm256_cmpeq_epi8(block, newline));
+            if(found != 0)
+                return begin + __builtin_ctzll(found);
+        }
+        return find_newline_scalar(begin, end);
+    }
+
+    __attribute__((target("avx2")))
+    Masks classify_block_avx2(char const* data)
+    {
+        Masks masks{ 0, 0, 0, 0 };
+        for(std::size_t i = 0; i < mask_bits; i += 32)
+        {
+            auto bytes = _mm256_loadu_si256(
+                reinterpret_cast<__m256i const*>(data + i));
+            auto newlines = _mm256_cmpeq_epi8(bytes, _mm256_set1_epi8('\n'));
+            auto spaces = _mm256_or_si256(
+                _mm256_cmpeq_epi8(bytes, _mm256_set1_epi8(' ')),
+                in_range_avx2(bytes, '\t', '\r' - '\t'));
+            auto digits = in_range_avx2(bytes, '0', 9);
+            auto punctuation = _mm256_or_si256(
+                in_range_avx2(bytes, ',', 1),
+                _mm256_cmpeq_epi8(bytes, _mm256_set1_epi8('/')));
+            auto name_chars = _mm256_or_si256(
+                _mm256_or_si256(digits, punctuation),
+                _mm256_or_si256(in_range_avx2(bytes, 'A', 25),
+                                in_range_avx2(bytes, 'a', 25)));
+
+            masks.newlines |= to_bits(newlines) << i;
+            masks.spaces |= to_bits(spaces) << i;
+            masks.digits |= to_bits(digits) << i;
+            masks.name_chars |= to_bits(name_chars) << i;
+        }
+        return masks;
+    }
+
+    __attribute__((target("avx2")))
+    void classify_avx2(char const* data, std::size_t size, Masks* masks)
+    {
+        classify_blocks(data, size, masks, classify_block_avx2);
+    }
+#endif
+
+    bool is_supported(scan::Kernel kernel)
+    {
+#if defined(__x86_64__)
+        // The kernels are chosen during the static initialization, which
+        // may come before the CPU detection has been initialized.
+        __builtin_cpu_init();
+        switch(kernel)
+        {
+            case scan::Kernel::scalar: return true;
+            case scan::Kernel::sse42: return __builtin_cpu_supports("sse4.2");
+            case scan::Kernel::avx2: return __builtin_cpu_supports("avx2");
+        }
+        return false;
+#else
+        return kernel == scan::Kernel::scalar;
+#endif
+    }
+
+    struct Kernels
+    {
+        scan::Kernel kernel;
+        char const* (*find_newline)(char const*, char const*);
+        void (*classify)(char const*, std::size_t, Masks*);
+    };
+
+    Kernels kernels_of(scan::Kernel kernel)
+    {
+#if defined(__x86_64__)
+        if(kernel == scan::Kernel::avx2)
+            return Kernels{ kernel, find_newline_avx2, classify_avx2 };
+        if(kernel == scan::Kernel::sse42)
+            return Kernels{ kernel, find_newline_sse42, classify_sse42 };
+#endif
+        return Kernels{ kernel, find_newline_scalar, classify_scalar };
+    }
+
+    Kernels best_kernels()
+    {
+        for(auto kernel : { scan::Kernel::avx2, scan::Kernel::sse42 })
+        {
+            if(is_supported(kernel))
+                return kernels_of(kernel);
+        }
+        return kernels_of(scan::Kernel::scalar);
+    }
+
+    Kernels kernels{ best_kernels() };
+}
+
+char const* scan::find_newline(char const* begin, char const* end)
+{
+    return kernels.find_newline(begin, end);
+}
+
+void scan::classify(char const* data, std::size_t size, Masks* masks)
+{
+    kernels.classify(data, size, masks);
+}
+
+void scan::Line_scanner::refill()
+{
+    window = pos;
+    window_size = std::min<std::size_t>(end - pos, window_capacity);
+    window_end = window + window_size;
+    classify(window, window_size, blocks);
+    blocks[(window_size + mask_bits - 1) / mask_bits] = Masks{ 0, 0, 0, 0 };
+}
+
+scan::Kernel scan::current_kernel()
+{
+    return kernels.kernel;
+}
+
+bool scan::set_kernel(Kernel kernel)
+{
+    if(!is_supported(kernel))
+        return false;
+    kernels = kernels_of(kernel);
+    return true;
+}
+
+char const* scan::kernel_name(Kernel kernel)
+{
+    switch(kernel)
+    {
+        case Kernel::scalar: return "scalar";
+        case Kernel::sse42: return "sse4.2";
+        case Kernel::avx2: return "avx2";
+    }
+    return "unknown";
+}
@@ -0,0 +1,171 @@
+#ifndef SCAN_H
+#define SCAN_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+// Byte-level scanning of the input, used under the lexer. The input is
+// classified in large windows, 64 bytes at a time, into bitmaps of newlines,
+// whitespaces, digits and name characters; lines are then split and lexed
+// with bit operations on these bitmaps instead of checking the characters
+// one by one. Every kernel has a scalar version and, on x86-64, SSE4.2 and
+// AVX2 versions; the best one the CPU supports is chosen when the program
+// starts.
+namespace scan
+{
+    enum class Kernel
+    {
+        scalar,
+        sse42,
+        avx2
+    };
+
+    // Character classes of 64 bytes: bit i is set if byte i is in the class.
+    // Bits past the end of the data are always clear.
+    struct Masks
+    {
+        std::uint64_t newlines;
+        std::uint64_t spaces;       // Same set as \s, see lexer::is_space.
+        std::uint64_t digits;       // 0-9.
+        std::uint64_t name_chars;   // See lexer::is_name_char.
+    };
+
+    constexpr std::size_t mask_bits{ 64 };
+
+    // Returns the first '\n' in [begin, end), or [end] if there is none.
+    char const* find_newline(char const* begin, char const* end);
+
+    // Classifies the data into (size + 63) / 64 masks.
+    void classify(char const* data, std::size_t size, Masks* masks);
+
+    // Kernel used at the moment, and the way to change it (for the
+    // benchmarks and tests). Returns false if the CPU does not support the
+    // kernel. Must not be called while other threads are scanning.
+    Kernel current_kernel();
+    bool set_kernel(Kernel kernel);
+    char const* kernel_name(Kernel kernel);
+
+    // Position of the first clear bit of the mask at or after [pos], or
+    // mask_bits if there is none.
+    inline std::size_t run_end(std::uint64_t mask, std::size_t pos)
+    {
+        if(pos >= mask_bits)
+            return mask_bits;
+        auto rest = ~mask >> pos;
+        return rest == 0 ? mask_bits : pos + __builtin_ctzll(rest);
+    }
+
+    // Splits the data into lines (without the '\n'), classifying it on the
+    // way. Lines of less than mask_bits bytes, which are nearly all of them,
+    // come with their masks; the longer ones have to be lexed without them.
+    // With the scalar kernel the lines come without the masks, because
+    // checking the characters one by one is faster then.
+    class Line_scanner
+    {
+    public:
+        Line_scanner(char const* begin, char const* end)
+            : pos{ begin },
+              end{ end },
+              vector{ current_kernel() != Kernel::scalar },
+              window{ begin },
+              window_end{ begin }
+        {
+        }
+
+        // Returns false when there are no more lines. [masks] points to the
+        // masks of the line, or is null if there are none.
+        bool next(std::string_view& line, Masks const*& masks)
+        {
+            if(pos == end)
+                return false;
+
+            masks = nullptr;
+            if(!vector)
+            {
+                line = std::string_view{ pos, static_cast<std::size_t>(
+                    find_newline(pos, end) - pos) };
+                advance(line.size());
+                return true;
+            }
+
+            // The masks of the line are taken from the two blocks it spans,
+            // so both must be in the window.
+            auto offset = static_cast<std::size_t>(pos - window);
+            if(offset + 2 * mask_bits > window_size && window_end != end)
+            {
+                refill();
+                offset = 0;
+            }
+
+            auto const* low = blocks + offset / mask_bits;
+            auto shift = offset % mask_bits;
+            auto window_mask = [&](std::uint64_t low_mask,
+                                   std::uint64_t high_mask) {
+                // Shifting by 64 is undefined, hence the two steps.
+                return (low_mask >> shift)
+                    | (high_mask << (mask_bits - 1 - shift) << 1);
+            };
+
+            // Bits past the end of the data are clear, so the last line
+            // ends where the data does.
+            auto newlines = window_mask(low[0].newlines, low[1].newlines);
+            std::size_t length = newlines != 0 ? __builtin_ctzll(newlines)
+                                               : mask_bits;
+            auto available = static_cast<std::size_t>(end - pos);
+            if(length > available)
+                length = available;
+
+            if(length < mask_bits)
+            {
+                auto keep = (std::uint64_t{ 1 } << length) - 1;
+                line_masks.newlines = 0;
+                line_masks.spaces = window_mask(low[0].spaces, low[1].spaces)
+                    & keep;
+                line_masks.digits = window_mask(low[0].digits, low[1].digits)
+                    & keep;
+                line_masks.name_chars = window_mask(low[0].name_chars,
+                                                    low[1].name_chars) & keep;
+                masks = &line_masks;
+            }
+            else
+            {
+                length = find_newline(pos, end) - pos;
+            }
+
+            line = std::string_view{ pos, length };
+            advance(length);
+            return true;
+        }
+
+    private:
+        // Bytes classified at once, small enough for the masks to stay in
+        // the cache.
+        static constexpr std::size_t window_capacity{ 16 << 10 };
+
+        // Classifies the window starting at [pos].
+        void refill();
+
+        // Skips the line and its newline.
+        void advance(std::size_t length)
+        {
+            pos += length;
+            if(pos != end)
+                ++pos;
+        }
+
+        char const* pos;
+        char const* end;
+        bool vector;
+        char const* window;
+        char const* window_end;
+        std::size_t window_size{ 0 };
+
+        // One more block than the window needs, which stays clear, so that
+        // the masks of the last line can always be read from two blocks.
+        Masks blocks[window_capacity / mask_bits + 1];
+        Masks line_masks;
+    };
+}
+
+#endif
@@ -0,0 +1,74 @@
+#include <iomanip>
+#include <iostream>
+
+#include <sys/resource.h>
+
+#include "stats.h"
+
+using obwody::Stats;
+using obwody::Table_stats;
+
+namespace
+{
+    constexpr char const* phase_names[Stats::phase_count]{
+        "read", "lex", "ids", "add", "errors", "merge", "sort", "group",
+        "nodes", "index", "cache", "print"
+    };
+
+    void print_table(std::ostream& output, char const* name,
+                     Table_stats const& table)
+    {
+        output << name << ": " << table.size << " entries, "
+               << table.buckets << " buckets, load factor "
+               << (table.buckets == 0 ? 0.0
+                                      : double(table.size) / table.buckets)
+               << '\n';
+    }
+}
+
+void Stats::record_netlist(Netlist const& netlist)
+{
+    names = Table_stats{ netlist.names.size(),
+                         netlist.names.bucket_count() };
+    sparse_nodes = Table_stats{ netlist.node_table.sparse_size(),
+                                netlist.node_table.sparse_bucket_count() };
+    dense_node_slots = netlist.node_table.dense_size();
+}
+
+void Stats::report(std::ostream& output,
+                   std::chrono::steady_clock::time_point start) const
+{
+    std::chrono::duration<double> total{
+        std::chrono::steady_clock::now() - start };
+
+    auto flags = output.flags();
+    output << std::fixed << std::setprecision(6) << "Statistics:\n";
+    double parse_seconds{ 0 };
+    for(int phase = 0; phase < phase_count; ++phase)
+    {
+        if(phase <= merge)
+            parse_seconds += seconds[phase];
+        output << std::setw(8) << phase_names[phase] << ": "
+               << seconds[phase] << " s\n";
+    }
+    output << std::setw(8) << "total" << ": " << total.count() << " s\n";
+
+    output << std::setprecision(0) << "lines: " << line_count << " ("
+           << (parse_seconds > 0 ? line_count / parse_seconds : 0.0)
+           << " lines/s)\n"
+           << "elements: " << element_count << ", errors: " << error_count
+           << ", groups: " << group_count << ", nodes: " << node_count
+           << '\n'
+           << std::setprecision(3);
+    print_table(output, "used_ids", used_ids);
+    print_table(output, "names", names);
+    print_table(output, "sparse nodes", sparse_nodes);
+    output << "dense node slots: " << dense_node_slots << '\n'
+           << "spilled runs: " << spilled_runs << '\n';
+
+    // The maximum resident set size is in kilobytes on Linux.
+    struct rusage usage;
+    if(getrusage(RUSAGE_SELF, &usage) == 0)
+        output << "peak memory: " << usage.ru_maxrss << " kB\n";
+    output.flags(flags);
+}
@@ -0,0 +1,125 @@
+#ifndef STATS_H
+#define STATS_H
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <iosfwd>
+
+#include "netlist.h"
+
+// Instrumentation of a run: wall time of the phases, counters and sizes of
+// the hash tables. The functions which can be instrumented take a Stats
+// pointer, which is null when the statistics are not collected, and then
+// nothing is measured: there is a single pointer check per phase, and the
+// loops over the lines are compiled without the timing for that case.
+namespace obwody
+{
+    // Size of a hash table and the number of its buckets.
+    struct Table_stats
+    {
+        std::size_t size{ 0 };
+        std::size_t buckets{ 0 };
+
+        template<typename Table>
+        void add(Table const& table)
+        {
+            size += table.size();
+            buckets += table.bucket_count();
+        }
+    };
+
+    struct Stats
+    {
+        enum Phase
+        {
+            read,       // Reading the lines of the input.
+            lex,        // Lexing the lines.
+            ids,        // Checking for the repeated ids in the used_ids.
+            add,        // Interning the names and connecting the nodes.
+            errors,     // Printing (or keeping) the errors.
+            merge,      // Merging the results of the threads.
+            sort,       // Sorting the elements.
+            group,      // Grouping them by name and type.
+            nodes,      // Ordering the nodes and their elements.
+            index,      // The remaining arrays of the index.
+            cache,      // Loading and saving the cache.
+            print,      // Printing the report.
+            phase_count
+        };
+
+        double seconds[phase_count]{};
+
+        std::uint64_t line_count{ 0 };
+        std::uint64_t element_count{ 0 };
+        std::uint64_t error_count{ 0 };
+        std::uint64_t group_count{ 0 };
+        std::uint64_t node_count{ 0 };
+
+        // used_ids, summed over the shards of the parallel parser, the index
+        // of the Name_pool, and the part of the Node_table which is a hash
+        // map (the nodes below the size of its array are not in it).
+        Table_stats used_ids;
+        Table_stats names;
+        Table_stats sparse_nodes;
+        std::size_t dense_node_slots{ 0 };
+
+        // Sorted runs written to the disk by the streaming mode, counting
+        // the merged ones.
+        std::uint64_t spilled_runs{ 0 };
+
+        // Records the sizes of the tables of the parsed netlist.
+        void record_netlist(Netlist const& netlist);
+
+        // Prints the statistics, with the total time since [start] and the
+        // peak memory use of the process.
+        void report(std::ostream& output,
+                    std::chrono::steady_clock::time_point start) const;
+    };
+
+    // Adds the time from its construction to its destruction to the phase.
+    class Phase_timer
+    {
+    public:
+        Phase_timer(Stats* stats_, Stats::Phase phase_)
+            : stats{ stats_ }, phase{ phase_ }
+        {
+            if(stats != nullptr)
+                start = std::chrono::steady_clock::now();
+        }
+
+        ~Phase_timer()
+        {
+            if(stats != nullptr)
+                stop();
+        }
+
+        // Ends the current phase and starts the next one.
+        void switch_to(Stats::Phase next)
+        {
+            if(stats == nullptr)
+                return;
+            auto now = stop();
+            phase = next;
+            start = now;
+        }
+
+        Phase_timer(Phase_timer const&) = delete;
+        Phase_timer& operator=(Phase_timer const&) = delete;
+
+    private:
+        std::chrono::steady_clock::time_point stop()
+        {
+            auto now = std::chrono::steady_clock::now();
+            std::chrono::duration<double> elapsed{ now - start };
+            stats->seconds[phase] += elapsed.count();
+            return now;
+        }
+
+        Stats* stats;
+        Stats::Phase phase;
+        std::chrono::steady_clock::time_point start;
+    };
+}
+
+#endif
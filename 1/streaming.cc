@@ -0,0 +1,322 @@
+#include <cstdlib>
+#include <istream>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include "external_sort.h"
+#include "netlist.h"
+#include "stats.h"
+#include "streaming.h"
+
+using obwody::Buffered_writer;
+using obwody::External_sorter;
+using obwody::Id;
+using obwody::Node_table;
+using obwody::Phase_timer;
+using obwody::Spill_file;
+using obwody::Stats;
+using obwody::Streaming_options;
+
+namespace
+{
+    // Record of the fixed [header] followed by the text. Headers have no
+    // padding, so they are written as they are.
+    template<typename Header>
+    struct Text_record
+    {
+        Header header;
+        std::string text;
+
+        std::size_t memory_size() const
+        {
+            return sizeof(Text_record) + text.size();
+        }
+
+        void write(Spill_file& file) const
+        {
+            std::uint64_t length{ text.size() };
+            file.write(&header, sizeof(header));
+            file.write(&length, sizeof(length));
+            file.write(text.data(), text.size());
+        }
+
+        bool read(Spill_file& file)
+        {
+            std::uint64_t length;
+            if(!file.read(&header, sizeof(header))
+               || !file.read(&length, sizeof(length)))
+                return false;
+            text.resize(length);
+            return file.read(text.data(), length);
+        }
+    };
+
+    // Correctly lexed line, with the name kept as the part of the text.
+    struct Line_header
+    {
+        std::uint64_t key;
+        std::uint64_t line_no;
+        int nodes[3];
+        int node_count;
+        std::uint32_t name_offset;
+        std::uint32_t name_length;
+    };
+
+    struct Error_header
+    {
+        std::uint64_t line_no;
+    };
+
+    // Correct element, with its name as the text.
+    struct Element_header
+    {
+        int priority;
+        int number;
+    };
+
+    // Element of the group starting with the element [first]. Only the first
+    // element has the name of the group as the text.
+    struct Ordered_header
+    {
+        int priority;
+        int first;
+        int number;
+    };
+
+    using Line_record = Text_record<Line_header>;
+    using Error_record = Text_record<Error_header>;
+    using Element_record = Text_record<Element_header>;
+    using Ordered_record = Text_record<Ordered_header>;
+
+    struct Line_less
+    {
+        bool operator()(Line_record const& lhs, Line_record const& rhs) const
+        {
+            return std::tie(lhs.header.key, lhs.header.line_no)
+                < std::tie(rhs.header.key, rhs.header.line_no);
+        }
+    };
+
+    struct Error_less
+    {
+        bool operator()(Error_record const& lhs,
+                        Error_record const& rhs) const
+        {
+            return lhs.header.line_no < rhs.header.line_no;
+        }
+    };
+
+    struct Element_less
+    {
+        bool operator()(Element_record const& lhs,
+                        Element_record const& rhs) const
+        {
+            return std::tie(lhs.text, lhs.header.priority, lhs.header.number)
+                < std::tie(rhs.text, rhs.header.priority, rhs.header.number);
+        }
+    };
+
+    struct Ordered_less
+    {
+        bool operator()(Ordered_record const& lhs,
+                        Ordered_record const& rhs) const
+        {
+            return std::tie(lhs.header.priority, lhs.header.first,
+                            lhs.header.number)
+                < std::tie(rhs.header.priority, rhs.header.first,
+                           rhs.header.number);
+        }
+    };
+
+    void write_element(Buffered_writer& output, int priority, int number)
+    {
+        output.write(obwody::types_by_priority[priority]);
+        output.write_number(number);
+    }
+
+    // The warnings of print_report(), made from the Node_table instead of
+    // the index.
+    void write_node_warnings(Node_table& table, bool report_floating,
+                             Buffered_writer& errors)
+    {
+        table.add_node(0);
+        auto indices = table.indices_in_order();
+
+        std::vector<int> unconnected_nodes;
+        for(auto index : indices)
+        {
+            if(table.connection_count(index) < 2)
+                unconnected_nodes.push_back(table.node(index));
+        }
+        if(!unconnected_nodes.empty())
+        {
+            obwody::write_node_warning(errors, "Warning, unconnected node(s)",
+                                       unconnected_nodes.begin(),
+                                       unconnected_nodes.end());
+        }
+
+        if(report_floating)
+        {
+            obwody::write_floating_warnings(
+                obwody::group_components(table, indices), errors);
+        }
+    }
+}
+
+bool obwody::stream_report(std::istream& input,
+                           Streaming_options const& options,
+                           Buffered_writer& output,
+                           Buffered_writer& errors,
+                           Stats* stats)
+{
+    std::string directory{ options.spill_dir };
+    if(directory.empty())
+    {
+        char const* tmpdir = std::getenv("TMPDIR");
+        directory = tmpdir != nullptr && *tmpdir != '\0' ? tmpdir : "/tmp";
+    }
+
+    // At most two sorters take records at once, and the ones which are
+    // merging hold at most a quarter of the budget then.
+    auto budget = options.memory_budget;
+    External_sorter<Line_record, Line_less> lines{ budget / 2, directory };
+    External_sorter<Error_record, Error_less> error_lines{ budget / 4,
+                                                           directory };
+    External_sorter<Element_record, Element_less> elements{ budget / 4,
+                                                            directory };
+    External_sorter<Ordered_record, Ordered_less> ordered{ budget / 2,
+                                                           directory };
+
+    Phase_timer timer{ stats, Stats::lex };
+    std::string line;
+    std::uint64_t line_no{ 1 };
+    for(; std::getline(input, line); ++line_no)
+    {
+        if(line.empty())
+            continue;
+
+        lexer::Parsed_line parsed;
+        if(!lexer::parse_line(line, parsed))
+        {
+            error_lines.push(Error_record{ { line_no }, line });
+            continue;
+        }
+
+        Line_header header{ Id{ parsed.type, parsed.number }.key,
+                            line_no,
+                            { parsed.nodes[0], parsed.nodes[1],
+                              parsed.nodes[2] },
+                            parsed.node_count,
+                            static_cast<std::uint32_t>(
+                                parsed.name.data() - line.data()),
+                            static_cast<std::uint32_t>(parsed.name.size()) };
+        lines.push(Line_record{ header, line });
+    }
+
+    // The first line of every id is the correct one.
+    timer.switch_to(Stats::ids);
+    Node_table node_table;
+    std::uint64_t element_count{ 0 };
+    bool any_line{ false };
+    std::uint64_t previous_key{ 0 };
+    lines.merge([&](Line_record& record) {
+        auto const& header = record.header;
+        if(any_line && header.key == previous_key)
+        {
+            error_lines.push(Error_record{ { header.line_no },
+                                           std::move(record.text) });
+            return;
+        }
+        any_line = true;
+        previous_key = header.key;
+
+        ++element_count;
+        node_table.connect(header.nodes, header.node_count);
+        Id id;
+        id.key = header.key;
+        elements.push(Element_record{
+            { element_priority(id.type()), id.number() },
+            record.text.substr(header.name_offset, header.name_length) });
+    });
+
+    timer.switch_to(Stats::errors);
+    std::uint64_t error_count{ 0 };
+    error_lines.merge([&](Error_record const& record) {
+        ++error_count;
+        errors.write("Error in line ");
+        errors.write_number(record.header.line_no);
+        errors.write(": ");
+        errors.write(record.text);
+        errors.write('\n');
+    });
+
+    // Elements of a group come one after another, the first one is the
+    // smallest.
+    timer.switch_to(Stats::group);
+    std::uint64_t group_count{ 0 };
+    std::string group_name;
+    Ordered_header group{ -1, 0, 0 };
+    elements.merge([&](Element_record& record) {
+        auto const& header = record.header;
+        bool first = group.priority != header.priority
+            || group_name != record.text;
+        if(first)
+        {
+            ++group_count;
+            group_name = record.text;
+            group = Ordered_header{ header.priority, header.number, 0 };
+        }
+        ordered.push(Ordered_record{
+            { group.priority, group.first, header.number },
+            first ? std::move(record.text) : std::string{} });
+    });
+
+    // Groups are ordered by their first elements, as in build_image().
+    timer.switch_to(Stats::print);
+    bool any_group{ false };
+    ordered.merge([&](Ordered_record& record) {
+        auto const& header = record.header;
+        if(header.number != header.first)
+        {
+            output.write(", ");
+            write_element(output, header.priority, header.number);
+            return;
+        }
+
+        if(any_group)
+        {
+            output.write(": ");
+            output.write(group_name);
+            output.write('\n');
+        }
+        any_group = true;
+        group_name = std::move(record.text);
+        write_element(output, header.priority, header.number);
+    });
+    if(any_group)
+    {
+        output.write(": ");
+        output.write(group_name);
+        output.write('\n');
+    }
+
+    write_node_warnings(node_table, options.report_floating, errors);
+
+    if(stats != nullptr)
+    {
+        stats->line_count += line_no - 1;
+        stats->element_count += element_count;
+        stats->error_count += error_count;
+        stats->group_count += group_count;
+        stats->node_count += node_table.size();
+        stats->sparse_nodes = obwody::Table_stats{
+            node_table.sparse_size(), node_table.sparse_bucket_count() };
+        stats->dense_node_slots = node_table.dense_size();
+        stats->spilled_runs += lines.spilled_run_count()
+            + error_lines.spilled_run_count() + elements.spilled_run_count()
+            + ordered.spilled_run_count();
+    }
+    return !lines.failed() && !error_lines.failed() && !elements.failed()
+        && !ordered.failed();
+}
@@ -0,0 +1,49 @@
+#ifndef STREAMING_H
+#define STREAMING_H
+
+#include <cstddef>
+#include <iosfwd>
+#include <string>
+
+#include "report.h"
+
+// Processing of netlists larger than the memory. Instead of the used_ids set
+// and the interned names, the lines are kept as records, which are sorted
+// with the External_sorter (see external_sort.h) in a few passes:
+// 1. The correct lines are sorted by the id and the line number, so the
+//    first line of every id is the correct one and the others are repeated.
+//    The elements are connected to the nodes then.
+// 2. The errors are sorted by the line number and printed.
+// 3. The elements are sorted by the name, the type and the number, which
+//    makes the groups.
+// 4. The elements are sorted by the first element of their group, and the
+//    groups are printed.
+// The report is the same as in the other modes. Only the Node_table stays in
+// the memory, which takes a few dozen bytes per node.
+namespace obwody
+{
+    struct Stats;
+
+    struct Streaming_options
+    {
+        // Bytes of the records kept in the memory, split between the sorters
+        // working at the same time.
+        std::size_t memory_budget{ std::size_t{ 256 } << 20 };
+
+        // Where the sorted runs are written, the TMPDIR or /tmp if empty.
+        std::string spill_dir;
+
+        bool report_floating{ false };
+    };
+
+    // Parses the input line by line and prints the report. Returns false if
+    // the runs could not be written, in which case the report is not
+    // complete.
+    bool stream_report(std::istream& input,
+                       Streaming_options const& options,
+                       Buffered_writer& output,
+                       Buffered_writer& errors,
+                       Stats* stats = nullptr);
+}
+
+#endif
@@ -0,0 +1,456 @@
+#include <algorithm>
+
+#include "netlist_index.h"
+#include "subcircuit.h"
+
+using obwody::Buffered_writer;
+using obwody::Error_log;
+using obwody::Id;
+using obwody::Id_set;
+using obwody::Name;
+using obwody::Netlist;
+using obwody::Netlist_index;
+using obwody::Node_table;
+using obwody::Subcircuit_netlist;
+
+namespace
+{
+    // Splits the line into the tokens separated with whitespaces.
+    std::vector<std::string_view> split_tokens(std::string_view line)
+    {
+        lexer::Scalar_classes classes{ line };
+        std::vector<std::string_view> tokens;
+        auto pos = classes.spaces_end(0);
+        while(pos < line.size())
+        {
+            auto start = pos;
+            while(pos < line.size() && !lexer::is_space(line[pos]))
+                ++pos;
+            tokens.push_back(line.substr(start, pos - start));
+            pos = classes.spaces_end(pos);
+        }
+        return tokens;
+    }
+
+    // Checks that the whole token is a number, the same as in the elements.
+    bool parse_number(std::string_view token, int& value)
+    {
+        std::size_t pos{ 0 };
+        return lexer::lex_number(token, lexer::Scalar_classes{ token }, pos,
+                                 value)
+            && pos == token.size();
+    }
+
+    // Checks that the whole token is a name, the same as of the elements.
+    bool is_name(std::string_view token)
+    {
+        return !token.empty() && lexer::is_name_start(token[0])
+            && std::all_of(token.begin(), token.end(), lexer::is_name_char);
+    }
+}
+
+struct Subcircuit_netlist::Instance
+{
+    Id id;
+    Name definition;
+    std::vector<int> nodes;
+    std::size_t line_no;
+    std::string line;
+
+    // Set if the definition exists, has the same number of ports and does
+    // not instance, directly or not, the scope of the instance.
+    bool valid{ false };
+};
+
+// The top level circuit or a single definition.
+struct Subcircuit_netlist::Scope
+{
+    enum class State
+    {
+        unresolved,
+        resolving,
+        resolved
+    };
+
+    // Only for the definitions: the name, the ports and the .SUBCKT line.
+    Name name{ 0 };
+    std::vector<int> ports;
+    std::size_t line_no{ 0 };
+    std::string line;
+
+    Netlist netlist;
+    Id_set used_ids;
+    std::vector<Instance> instances;
+    State state{ State::unresolved };
+
+    // The summary. Terminals are the nodes seen from the outside: the
+    // ground and the ports, in order. For every terminal, the number of
+    // connections to it inside, and the position of the first terminal
+    // connected to it inside.
+    std::vector<int> terminals{ 0 };
+    std::vector<int> terminal_counts;
+    std::vector<std::size_t> terminal_components;
+
+    // The elements list of the definition.
+    std::string groups;
+
+    // Writes the warning about the unconnected nodes. The terminals of the
+    // definitions are left out, as they are connected from the outside.
+    void write_unconnected(std::string_view definition,
+                           Buffered_writer& errors);
+
+    // Writes the warnings about the parts not connected to any terminal.
+    void write_floating(std::string_view definition,
+                        Buffered_writer& errors);
+};
+
+void Subcircuit_netlist::Scope::write_unconnected(
+    std::string_view definition,
+    Buffered_writer& errors)
+{
+    auto const& table = netlist.node_table;
+    std::vector<bool> is_terminal(table.size());
+    if(!definition.empty())
+    {
+        for(auto terminal : terminals)
+            is_terminal[table.find_index(terminal)] = true;
+    }
+
+    std::vector<int> unconnected_nodes;
+    for(auto index : table.indices_in_order())
+    {
+        if(table.connection_count(index) < 2 && !is_terminal[index])
+            unconnected_nodes.push_back(table.node(index));
+    }
+    if(!unconnected_nodes.empty())
+    {
+        write_node_warning(errors, "Warning, unconnected node(s)",
+                           unconnected_nodes.begin(), unconnected_nodes.end(),
+                           definition);
+    }
+}
+
+// Components come out in the same order as in the report of a flat netlist.
+void Subcircuit_netlist::Scope::write_floating(std::string_view definition,
+                                               Buffered_writer& errors)
+{
+    auto& table = netlist.node_table;
+    auto indices = table.indices_in_order();
+    std::vector<bool> grounded(indices.size());
+    for(auto terminal : terminals)
+        grounded[table.find(table.find_index(terminal))] = true;
+
+    auto components = group_components(table, indices);
+    for(std::size_t position = 0; position < indices.size(); ++position)
+    {
+        auto begin = components.offsets[position];
+        auto end = components.offsets[position + 1];
+        if(begin == end || grounded[table.find(indices[position])])
+            continue;
+
+        write_node_warning(errors,
+                           "Warning, sub-circuit not connected to the ground",
+                           components.nodes.begin() + begin,
+                           components.nodes.begin() + end, definition);
+    }
+}
+
+Subcircuit_netlist::Subcircuit_netlist()
+    : top{ std::make_unique<Scope>() }, current{ top.get() }
+{
+}
+
+Subcircuit_netlist::~Subcircuit_netlist() = default;
+
+void Subcircuit_netlist::report_error(std::size_t line_no,
+                                      std::string_view line)
+{
+    error_lines.emplace_back(line_no, std::string{ line });
+}
+
+void Subcircuit_netlist::add_line(std::string_view line)
+{
+    ++line_count;
+
+    // The lines of the elements, which are the most of the input, go
+    // straight to the lexer.
+    auto start = lexer::Scalar_classes{ line }.spaces_end(0);
+    char first = start < line.size() ? line[start] : '\0';
+    if(first == '.')
+    {
+        auto directive = split_tokens(line)[0];
+        if(directive == ".SUBCKT")
+            begin_definition(line);
+        else if(directive == ".ENDS")
+            end_definition(line);
+        else
+            report_error(line_count, line);
+    }
+    else if(first == 'X')
+    {
+        add_instance(line);
+    }
+    else if(!process_input_line(line, current->used_ids, current->netlist))
+    {
+        report_error(line_count, line);
+    }
+}
+
+void Subcircuit_netlist::add_instance(std::string_view line)
+{
+    // X<number> <subcircuit> <node>...
+    auto tokens = split_tokens(line);
+    Instance instance;
+    int number{ 0 };
+    bool correct = tokens.size() >= 3
+        && parse_number(tokens[0].substr(1), number)
+        && is_name(tokens[1]);
+    for(std::size_t i = 2; correct && i < tokens.size(); ++i)
+    {
+        instance.nodes.emplace_back();
+        correct = parse_number(tokens[i], instance.nodes.back());
+    }
+    if(!correct || !current->used_ids.emplace('X', number).second)
+    {
+        report_error(line_count, line);
+        return;
+    }
+
+    instance.id = Id{ 'X', number };
+    instance.definition = definition_names.intern(tokens[1]);
+    instance.line_no = line_count;
+    instance.line = std::string{ line };
+    current->instances.push_back(std::move(instance));
+}
+
+void Subcircuit_netlist::begin_definition(std::string_view line)
+{
+    // .SUBCKT <name> <port>..., with distinct ports other than the ground.
+    auto tokens = split_tokens(line);
+    auto scope = std::make_unique<Scope>();
+    bool correct = current == top.get() && tokens.size() >= 2
+        && is_name(tokens[1]);
+    for(std::size_t i = 2; correct && i < tokens.size(); ++i)
+    {
+        scope->ports.emplace_back();
+        correct = parse_number(tokens[i], scope->ports.back())
+            && scope->ports.back() != 0;
+    }
+    if(correct)
+    {
+        std::vector<int> sorted_ports(scope->ports);
+        std::sort(sorted_ports.begin(), sorted_ports.end());
+        correct = std::adjacent_find(sorted_ports.begin(), sorted_ports.end())
+            == sorted_ports.end();
+    }
+    if(!correct)
+    {
+        report_error(line_count, line);
+        return;
+    }
+
+    scope->name = definition_names.intern(tokens[1]);
+    scope->terminals.insert(scope->terminals.end(), scope->ports.begin(),
+                            scope->ports.end());
+    scope->line_no = line_count;
+    scope->line = std::string{ line };
+    current = scope.get();
+
+    // The lines of a repeated definition are still checked, but it is not
+    // used.
+    definition_of.resize(definition_names.size(), nullptr);
+    if(definition_of[scope->name] != nullptr)
+        report_error(line_count, line);
+    else
+        definition_of[scope->name] = scope.get();
+    definitions.push_back(std::move(scope));
+}
+
+void Subcircuit_netlist::end_definition(std::string_view line)
+{
+    // .ENDS, or .ENDS <name> of the definition it ends.
+    auto tokens = split_tokens(line);
+    bool correct = current != top.get()
+        && (tokens.size() == 1
+            || (tokens.size() == 2
+                && tokens[1] == definition_names[current->name]));
+    if(!correct)
+    {
+        report_error(line_count, line);
+        return;
+    }
+    current = top.get();
+}
+
+void Subcircuit_netlist::resolve(Scope& scope, std::vector<Scope*>& order)
+{
+    scope.state = Scope::State::resolving;
+    for(auto& instance : scope.instances)
+    {
+        auto* definition = definition_of[instance.definition];
+        instance.valid = definition != nullptr
+            && definition->ports.size() == instance.nodes.size()
+            && definition->state != Scope::State::resolving;
+        if(!instance.valid)
+        {
+            report_error(instance.line_no, instance.line);
+            continue;
+        }
+        if(definition->state == Scope::State::unresolved)
+            resolve(*definition, order);
+    }
+    scope.state = Scope::State::resolved;
+    order.push_back(&scope);
+}
+
+void Subcircuit_netlist::summarize(Scope& scope, Buffered_writer& groups)
+{
+    auto& netlist = scope.netlist;
+    for(auto const& instance : scope.instances)
+    {
+        if(!instance.valid)
+            continue;
+        auto name = netlist.names.intern(
+            definition_names[instance.definition]);
+        netlist.elements.push_back(obwody::Element{ instance.id, name,
+                                                    { 0, 0, 0 }, 0 });
+    }
+
+    // The elements list is printed before the connections inside the
+    // instances are added, as the index has only the elements' own.
+    {
+        Netlist_index index{ netlist, Error_log{} };
+        print_groups(index.image(), groups);
+    }
+
+    // Every instance adds the connections inside its definition to the
+    // nodes bound to its terminals, and connects the nodes whose terminals
+    // are connected inside.
+    auto& table = netlist.node_table;
+    std::vector<int> bound_nodes;
+    for(auto const& instance : scope.instances)
+    {
+        if(!instance.valid)
+            continue;
+        auto const& definition = *definition_of[instance.definition];
+        bound_nodes.assign(1, 0);
+        bound_nodes.insert(bound_nodes.end(), instance.nodes.begin(),
+                           instance.nodes.end());
+        for(std::size_t i = 0; i < bound_nodes.size(); ++i)
+        {
+            // Nothing inside is connected to the terminal, so as with the
+            // flattened netlist, the instance does not make the node.
+            if(definition.terminal_counts[i] == 0)
+                continue;
+            table.add_connections(bound_nodes[i],
+                                  definition.terminal_counts[i]);
+            table.join(bound_nodes[i],
+                       bound_nodes[definition.terminal_components[i]]);
+        }
+    }
+
+    for(auto terminal : scope.terminals)
+        table.add_node(terminal);
+    std::vector<Node_table::Index> first_terminal_of_root(
+        table.size(), Node_table::no_index);
+    for(std::size_t i = 0; i < scope.terminals.size(); ++i)
+    {
+        auto index = table.find_index(scope.terminals[i]);
+        auto& first = first_terminal_of_root[table.find(index)];
+        if(first == Node_table::no_index)
+            first = i;
+        scope.terminal_counts.push_back(table.connection_count(index));
+        scope.terminal_components.push_back(first);
+    }
+}
+
+void Subcircuit_netlist::print_report(bool report_floating,
+                                      Buffered_writer& output,
+                                      Buffered_writer& errors)
+{
+    if(current != top.get())
+        report_error(current->line_no, current->line);
+    current = top.get();
+    definition_of.resize(definition_names.size(), nullptr);
+
+    // All the instances are checked first, so that the errors can be
+    // printed before anything else.
+    std::vector<Scope*> order;
+    for(auto& definition : definitions)
+    {
+        if(definition->state == Scope::State::unresolved)
+            resolve(*definition, order);
+    }
+    resolve(*top, order);
+
+    std::stable_sort(error_lines.begin(), error_lines.end(),
+                     [](auto const& lhs, auto const& rhs) {
+                         return lhs.first < rhs.first;
+                     });
+    for(auto const& error : error_lines)
+    {
+        errors.write("Error in line ");
+        errors.write_number(error.first);
+        errors.write(": ");
+        errors.write(error.second);
+        errors.write('\n');
+    }
+
+    // The top level comes last in the order, after all the definitions.
+    for(auto* scope : order)
+    {
+        if(scope == top.get())
+        {
+            summarize(*scope, output);
+            continue;
+        }
+        Buffered_writer groups{ scope->groups };
+        summarize(*scope, groups);
+    }
+
+    // Repeated definitions are left out, they were only checked.
+    std::vector<Scope*> used_definitions;
+    for(auto& definition : definitions)
+    {
+        if(definition_of[definition->name] == definition.get())
+            used_definitions.push_back(definition.get());
+    }
+
+    for(auto* definition : used_definitions)
+    {
+        output.write(".SUBCKT ");
+        output.write(definition_names[definition->name]);
+        for(auto port : definition->ports)
+        {
+            output.write(' ');
+            output.write_number(port);
+        }
+        output.write('\n');
+        output.write(definition->groups);
+        output.write(".ENDS\n");
+    }
+
+    top->write_unconnected({}, errors);
+    for(auto* definition : used_definitions)
+    {
+        definition->write_unconnected(definition_names[definition->name],
+                                      errors);
+    }
+    if(!report_floating)
+        return;
+
+    top->write_floating({}, errors);
+    for(auto* definition : used_definitions)
+    {
+        definition->write_floating(definition_names[definition->name],
+                                   errors);
+    }
+}
+
+void Subcircuit_netlist::print_report(bool report_floating)
+{
+    // The elements list is flushed first, as the output is destroyed first.
+    Buffered_writer errors{ stderr };
+    Buffered_writer output{ stdout };
+    print_report(report_floating, output, errors);
+}
@@ -0,0 +1,100 @@
+#ifndef SUBCIRCUIT_H
+#define SUBCIRCUIT_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "netlist.h"
+#include "report.h"
+
+// Hierarchical netlists, with subcircuit definitions and their instances:
+//
+//     .SUBCKT AMP 1 2 3      definition of AMP with the ports 1, 2 and 3,
+//     T1 BC107 1 2 4         its elements, on the nodes local to it,
+//     X1 STAGE 4 3           and instances of other subcircuits,
+//     .ENDS                  end of the definition (or .ENDS AMP),
+//     X7 AMP 11 12 0         instance of AMP, binding its ports to 11, 12, 0.
+//
+// Node 0 is the ground everywhere, the other nodes of a definition are local
+// to it, and ids only have to be unique within it. Definitions can not be
+// nested, but can be defined after their instances. The ports of an instance
+// stay distinct terminals even if they are bound to the same node (or one of
+// them to the ground), so an element between them is still correct, unlike in
+// the flattened netlist.
+//
+// Every definition is analysed once, however many times it is instanced. Its
+// summary says how many connections reach every port from the inside and
+// which ports are connected with each other, and an instance only adds these
+// to the nodes it binds. So the analysis takes time proportional to the size
+// of the input, not of the flattened netlist.
+namespace obwody
+{
+    class Subcircuit_netlist
+    {
+    public:
+        Subcircuit_netlist();
+        ~Subcircuit_netlist();
+
+        Subcircuit_netlist(Subcircuit_netlist const&) = delete;
+        Subcircuit_netlist& operator=(Subcircuit_netlist const&) = delete;
+
+        // Adds the next line of the input.
+        void add_line(std::string_view line);
+
+        // Ends the input and prints the report. The top level circuit is
+        // reported as a flat netlist would be, with the instances listed as
+        // the X elements named after their subcircuits, and it is followed by
+        // the elements lists of the definitions, each between its .SUBCKT and
+        // .ENDS lines. Errors come first, in line order, and then the
+        // warnings, first about the top level nodes and then about the nodes
+        // internal to the definitions.
+        void print_report(bool report_floating,
+                          Buffered_writer& output,
+                          Buffered_writer& errors);
+
+        // Prints the report to the stdout and stderr.
+        void print_report(bool report_floating);
+
+    private:
+        struct Scope;
+        struct Instance;
+
+        void add_instance(std::string_view line);
+        void begin_definition(std::string_view line);
+        void end_definition(std::string_view line);
+
+        // Checks the instances of the scope and of the definitions it
+        // instances, and appends the scopes to the [order] so that every
+        // definition comes after the ones it instances.
+        void resolve(Scope& scope, std::vector<Scope*>& order);
+
+        // Prints the elements list of the scope and computes its summary,
+        // after the summaries of all the subcircuits it instances.
+        void summarize(Scope& scope, Buffered_writer& groups);
+
+        void report_error(std::size_t line_no, std::string_view line);
+
+        std::unique_ptr<Scope> top;
+        std::vector<std::unique_ptr<Scope>> definitions;
+
+        // Names of the subcircuits, both defined and instanced, and their
+        // definitions, or null for the ones not defined.
+        Name_pool definition_names;
+        std::vector<Scope*> definition_of;
+
+        // The scope the lines are added to, and the number of the last line.
+        Scope* current;
+        std::size_t line_count{ 0 };
+
+        // Errors can be found only after the whole input is read, so they are
+        // sorted by the line number before printing.
+        std::vector<std::pair<std::size_t, std::string>> error_lines;
+    };
+}
+
+#endif
@@ -0,0 +1,117 @@
+#include "thread_pool.h"
+
+using obwody::Thread_pool;
+
+namespace
+{
+    // Index of the pool worker running on this thread, or -1 outside of the
+    // pools.
+    thread_local std::size_t current_worker{ static_cast<std::size_t>(-1) };
+    thread_local Thread_pool const* current_pool{ nullptr };
+}
+
+Thread_pool::Thread_pool(std::size_t thread_count)
+{
+    if(thread_count == 0)
+        thread_count = 1;
+
+    for(std::size_t i = 0; i < thread_count; ++i)
+        queues.push_back(std::make_unique<Task_queue>());
+    threads.reserve(thread_count);
+    for(std::size_t i = 0; i < thread_count; ++i)
+        threads.emplace_back([this, i] { run(i); });
+}
+
+Thread_pool::~Thread_pool()
+{
+    wait();
+    {
+        std::lock_guard<std::mutex> lock{ mutex };
+        stopping = true;
+    }
+    work_available.notify_all();
+    for(auto& thread : threads)
+        thread.join();
+}
+
+void Thread_pool::submit(std::function<void()> task)
+{
+    std::size_t queue;
+    {
+        std::lock_guard<std::mutex> lock{ mutex };
+        queue = current_pool == this ? current_worker
+                                     : next_queue++ % queues.size();
+        ++unfinished;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock{ queues[queue]->mutex };
+        queues[queue]->tasks.push_back(std::move(task));
+    }
+
+    // The task is counted as queued only once it is in the deque, so that a
+    // worker which claimed it always finds it.
+    {
+        std::lock_guard<std::mutex> lock{ mutex };
+        ++queued;
+    }
+    work_available.notify_one();
+}
+
+void Thread_pool::wait()
+{
+    std::unique_lock<std::mutex> lock{ mutex };
+    all_finished.wait(lock, [&] { return unfinished == 0; });
+}
+
+std::function<void()> Thread_pool::take(std::size_t worker)
+{
+    // There is a task for every claim, but it may be taken by another worker
+    // which finds this one's first, so look until one is found.
+    for(;;)
+    {
+        for(std::size_t i = 0; i < queues.size(); ++i)
+        {
+            auto& queue = *queues[(worker + i) % queues.size()];
+            std::lock_guard<std::mutex> lock{ queue.mutex };
+            if(queue.tasks.empty())
+                continue;
+
+            std::function<void()> task;
+            if(i == 0)
+            {
+                task = std::move(queue.tasks.back());
+                queue.tasks.pop_back();
+            }
+            else
+            {
+                task = std::move(queue.tasks.front());
+                queue.tasks.pop_front();
+            }
+            return task;
+        }
+        std::this_thread::yield();
+    }
+}
+
+void Thread_pool::run(std::size_t worker)
+{
+    current_worker = worker;
+    current_pool = this;
+    for(;;)
+    {
+        {
+            std::unique_lock<std::mutex> lock{ mutex };
+            work_available.wait(lock, [&] { return queued > 0 || stopping; });
+            if(queued == 0)
+                return;
+            --queued;
+        }
+
+        take(worker)();
+
+        std::lock_guard<std::mutex> lock{ mutex };
+        if(--unfinished == 0)
+            all_finished.notify_all();
+    }
+}
@@ -0,0 +1,68 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace obwody
+{
+    // Pool of threads with work stealing. Every thread has its own deque of
+    // tasks: it takes them from the back of its own deque and, when that is
+    // empty, steals from the front of the others'. Tasks submitted from the
+    // outside are spread over the deques in turn, tasks submitted by a task
+    // go to the deque of its thread.
+    class Thread_pool
+    {
+    public:
+        explicit Thread_pool(std::size_t thread_count);
+
+        // Waits for all the tasks to finish.
+        ~Thread_pool();
+
+        Thread_pool(Thread_pool const&) = delete;
+        Thread_pool& operator=(Thread_pool const&) = delete;
+
+        void submit(std::function<void()> task);
+
+        // Waits until all the submitted tasks are finished.
+        void wait();
+
+        std::size_t thread_count() const
+        {
+            return threads.size();
+        }
+
+    private:
+        struct Task_queue
+        {
+            std::mutex mutex;
+            std::deque<std::function<void()>> tasks;
+        };
+
+        void run(std::size_t worker);
+
+        // Takes a task, from the worker's own deque if possible.
+        std::function<void()> take(std::size_t worker);
+
+        std::vector<std::unique_ptr<Task_queue>> queues;
+        std::vector<std::thread> threads;
+
+        // [queued] is the number of tasks in the deques which no worker has
+        // claimed yet, [unfinished] also counts the running ones.
+        std::mutex mutex;
+        std::condition_variable work_available;
+        std::condition_variable all_finished;
+        std::size_t queued{ 0 };
+        std::size_t unfinished{ 0 };
+        std::size_t next_queue{ 0 };
+        bool stopping{ false };
+    };
+}
+
+#endif
@@ -1,10 +1,23 @@
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <climits>
+#include <deque>
 #include <iostream>
-#include <set>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
 #include <string>
+#include <string_view>
+#include <thread>
 #include <unordered_map>
+#include <utility>
+#include <vector>
 
 #include "strset.h"
 #include "strsetconst.h"
+#include "strset_table.h"
+#include "strset_tree.h"
 
 #ifdef NDEBUG
 const bool debug{false};
@@ -14,22 +27,465 @@ const bool debug{true};
 
 namespace {
 
-using Strset = std::set<std::string>;
-using Strsets_map = std::unordered_map<unsigned long, Strset>;
+// Elements of every set are kept in a B+tree, see strset_tree.h, or in a
+// table mapped from a file, see strset_table.h.
+using Strset = jnp1::Strset_tree;
+using Strset_table = jnp1::Strset_table;
+using Table_ptr = std::shared_ptr<const Strset_table>;
 
-// Returns the next free id and increments the coutner. Every time this
-// function is called the different value is returned (untill the integer
-// value overlaps, at least). This function correctly staticly initializes
-// the next free id.
-size_t get_and_increment_next_free_id() {
-    static size_t next_free_id{0};
-    return next_free_id++;
+// Ids are handles into a generational slot map: the lower half of the id is
+// the index of the slot the set is kept in, and the upper half is the
+// generation of the slot, which grows every time the set in the slot is
+// deleted. So the set is found with a single index, and the ids of the
+// deleted sets never match the sets which reuse their slots.
+constexpr int slot_bits{sizeof(unsigned long) * CHAR_BIT / 2};
+constexpr unsigned long slot_mask{(1UL << slot_bits) - 1};
+constexpr unsigned long max_generation{ULONG_MAX >> slot_bits};
+
+// Not a valid id, marks the free slots.
+constexpr unsigned long no_id{ULONG_MAX};
+
+unsigned long slot_of(unsigned long id) {
+    return id & slot_mask;
+}
+
+unsigned long generation_of(unsigned long id) {
+    return id >> slot_bits;
+}
+
+// The slots of the deleted sets are reused only when there are more of them
+// than this, and the oldest first. So the ids stay sequential in programs
+// which create few sets, and a deleted id is not reused for long.
+constexpr size_t min_free_ids{1024};
+
+// Ids which reuse the freed slots, with their generations already
+// increased.
+struct Free_ids {
+    std::mutex mutex;
+    std::deque<unsigned long> ids;
+    std::atomic<size_t> count{0};
+};
+
+// Correctly staticly initializes the free ids.
+Free_ids& get_free_ids() {
+    static Free_ids free_ids{};
+    return free_ids;
+}
+
+// Returns the next free id. Every time this function is called the different
+// value is returned, also when it is called from many threads at once: ids of
+// the new slots are counted up, and ids of the reused ones have new
+// generations. This function correctly staticly initializes the next free
+// slot.
+unsigned long get_and_increment_next_free_id() {
+    auto& free_ids = get_free_ids();
+    if (free_ids.count.load(std::memory_order_relaxed) > min_free_ids) {
+        std::lock_guard<std::mutex> lock{free_ids.mutex};
+        if (free_ids.ids.size() > min_free_ids) {
+            auto id = free_ids.ids.front();
+            free_ids.ids.pop_front();
+            free_ids.count.store(free_ids.ids.size(),
+                                 std::memory_order_relaxed);
+            return id;
+        }
+    }
+
+    static std::atomic<unsigned long> next_free_slot{0};
+    return next_free_slot.fetch_add(1, std::memory_order_relaxed);
 }
 
-// Correctly staticly initializes the strsets map.
-Strsets_map& get_strsets_map() {
-    static Strsets_map strsets_map{};
-    return strsets_map;
+// Makes the slot of the deleted set available for the new sets, unless its
+// generation would overflow.
+void free_id(unsigned long id) {
+    if (generation_of(id) == max_generation)
+        return;
+
+    auto& free_ids = get_free_ids();
+    std::lock_guard<std::mutex> lock{free_ids.mutex};
+    free_ids.ids.push_back(id + (1UL << slot_bits));
+    free_ids.count.store(free_ids.ids.size(), std::memory_order_relaxed);
+}
+
+// The slots are split into shards, so that the calls on the sets of
+// different shards do not wait for each other. Every shard has its own
+// reader/writer lock: the calls which only read a set (strset_test,
+// strset_size, strset_comp) take it shared, and may run at the same time
+// even on the same set.
+constexpr size_t shard_count{64};
+
+struct Slot {
+    unsigned long id{no_id};
+    Strset strset;
+    // The table of the set opened by strset_open_mapped(), which cannot be
+    // changed. Then the tree is empty.
+    Table_ptr table;
+};
+
+// The set as the functions which only read it see it: either its tree or
+// its table. Both are null if the set does not exist.
+struct Set_view {
+    const Strset* tree{nullptr};
+    const Strset_table* table{nullptr};
+
+    bool missing() const {
+        return tree == nullptr && table == nullptr;
+    }
+
+    size_t size() const {
+        return table != nullptr ? table->size() : tree->size();
+    }
+
+    bool contains(std::string_view value) const {
+        return table != nullptr ? table->contains(value)
+                                : tree->contains(value);
+    }
+
+    // The tables never change.
+    uint64_t version() const {
+        return table != nullptr ? 0 : tree->version();
+    }
+};
+
+// Aligned to the cache line, so that the locks of the neighbouring shards
+// do not share it. The slot s is kept in the shard s % shard_count, at the
+// index s / shard_count.
+struct alignas(64) Shard {
+    std::shared_mutex mutex;
+    std::vector<Slot> slots;
+
+    // Returns the slot of the set with the given id, or nullptr if the set
+    // does not exist.
+    Slot* find_slot(unsigned long id) {
+        auto index = slot_of(id) / shard_count;
+        if (index < slots.size() && slots[index].id == id)
+            return &slots[index];
+        return nullptr;
+    }
+
+    // Returns the tree of the set with the given id, or nullptr if the set
+    // does not exist or cannot be changed.
+    Strset* find(unsigned long id) {
+        auto* slot = find_slot(id);
+        if (slot == nullptr || slot->table != nullptr)
+            return nullptr;
+        return &slot->strset;
+    }
+
+    Set_view view(unsigned long id) {
+        auto* slot = find_slot(id);
+        if (slot == nullptr)
+            return {};
+        if (slot->table != nullptr)
+            return {nullptr, slot->table.get()};
+        return {&slot->strset, nullptr};
+    }
+
+    // Returns true if the set exists and is mapped from a file.
+    bool read_only(unsigned long id) {
+        auto* slot = find_slot(id);
+        return slot != nullptr && slot->table != nullptr;
+    }
+
+    // Creates the set in the free slot of the id.
+    void create(unsigned long id, Strset strset = {}, Table_ptr table = {}) {
+        auto index = slot_of(id) / shard_count;
+        if (index >= slots.size())
+            slots.resize(index + 1);
+        slots[index].id = id;
+        slots[index].strset = std::move(strset);
+        slots[index].table = std::move(table);
+    }
+
+    // Deletes the set, if it exists. Returns true if it existed.
+    bool erase(unsigned long id) {
+        auto* slot = find_slot(id);
+        if (slot == nullptr)
+            return false;
+        slot->strset = Strset{};
+        slot->table.reset();
+        slot->id = no_id;
+        return true;
+    }
+};
+
+// Correctly staticly initializes the shards.
+Shard& get_shard(unsigned long id) {
+    static std::array<Shard, shard_count> shards{};
+    return shards[slot_of(id) % shard_count];
+}
+
+// The locks are released before the debug messages are printed, because
+// printing them may call strset42(), which takes the locks when it creates
+// the 42 Set.
+using Read_lock = std::shared_lock<std::shared_mutex>;
+using Write_lock = std::unique_lock<std::shared_mutex>;
+
+// Locks both shards for reading, in the order of their addresses, and the
+// same shard only once.
+std::pair<Read_lock, Read_lock> lock_for_reading(Shard& shard1,
+                                                 Shard& shard2) {
+    Read_lock lock1{std::min(&shard1, &shard2)->mutex};
+    Read_lock lock2{};
+    if (&shard1 != &shard2)
+        lock2 = Read_lock{std::max(&shard1, &shard2)->mutex};
+    return {std::move(lock1), std::move(lock2)};
+}
+
+// We use it for all non-existing ids, so that they are treated the same as
+// if they were empty.
+const Strset& empty_set() {
+    static const Strset empty{};
+    return empty;
+}
+
+// Adds the set with a new id, and returns the id.
+unsigned long add_set(Strset strset, Table_ptr table = {}) {
+    auto id = get_and_increment_next_free_id();
+    auto& shard = get_shard(id);
+    Write_lock lock{shard.mutex};
+    shard.create(id, std::move(strset), std::move(table));
+    return id;
+}
+
+// Calls f(set1, set2) with the tree or the table of each set. The missing
+// sets are passed as the empty tree.
+template <typename F>
+auto visit(Set_view set1, Set_view set2, F f) {
+    const Strset& tree1{set1.tree != nullptr ? *set1.tree : empty_set()};
+    const Strset& tree2{set2.tree != nullptr ? *set2.tree : empty_set()};
+    if (set1.table != nullptr) {
+        if (set2.table != nullptr)
+            return f(*set1.table, *set2.table);
+        return f(*set1.table, tree2);
+    }
+    if (set2.table != nullptr)
+        return f(tree1, *set2.table);
+    return f(tree1, tree2);
+}
+
+// The name of the set in the debug messages. It is found before the message
+// is printed, because strset42() prints the messages of its own when it
+// creates the 42 Set.
+std::string set_name(unsigned long id) {
+    if (id == jnp1::strset42())
+        return "the 42 Set";
+    return "set " + std::to_string(id);
+}
+
+// Position of a cursor in its set, kept between the calls. It is found
+// again, after the last element returned, if the set has changed since it
+// was found. So the cursor stays valid, and sees the elements inserted
+// after its position, but not the ones removed.
+struct Cursor {
+    std::mutex mutex;
+    unsigned long id{no_id};
+    // The last element returned, or the lower bound of the elements until
+    // the first one is returned.
+    std::string value;
+    bool started{false};
+    // Whether the position was found at the version of the set.
+    bool positioned{false};
+    uint64_t version{0};
+    Strset::const_iterator tree_position;
+    Strset_table::const_iterator table_position;
+};
+
+template <typename Set, typename Iterator>
+bool advance(Cursor& cursor, const Set& set, Iterator& position,
+             bool position_valid) {
+    auto last = set.end();
+    if (!position_valid) {
+        position = set.lower_bound(cursor.value);
+        if (cursor.started && position != last && *position == cursor.value)
+            ++position;
+    }
+    else if (position != last) {
+        ++position;
+    }
+    if (position == last)
+        return false;
+    auto value = *position;
+    cursor.value.assign(value.data(), value.size());
+    cursor.started = true;
+    return true;
+}
+
+// Moves the cursor to the next element of the set, in a constant time if the
+// set has not changed. Returns false if there is none.
+bool advance(Cursor& cursor, Set_view set) {
+    bool position_valid = cursor.positioned
+                          && cursor.version == set.version();
+    cursor.positioned = true;
+    cursor.version = set.version();
+    if (set.table != nullptr)
+        return advance(cursor, *set.table, cursor.table_position,
+                       position_valid);
+    return advance(cursor, *set.tree, cursor.tree_position, position_valid);
+}
+
+// Cursors of strset_iter_begin(), by their ids. A cursor is used under its
+// own mutex, so the calls on different cursors do not wait for each other.
+struct Cursors {
+    std::mutex mutex;
+    std::unordered_map<unsigned long, std::shared_ptr<Cursor>> cursors;
+    unsigned long next_id{0};
+};
+
+// Correctly staticly initializes the cursors.
+Cursors& get_cursors() {
+    static Cursors cursors{};
+    return cursors;
+}
+
+std::shared_ptr<Cursor> find_cursor(unsigned long iter) {
+    auto& cursors = get_cursors();
+    std::lock_guard<std::mutex> lock{cursors.mutex};
+    auto found = cursors.cursors.find(iter);
+    if (found == cursors.cursors.end())
+        return nullptr;
+    return found->second;
+}
+
+// Counts the elements with the prefix, which follow one another from the
+// first element not less than it.
+template <typename Set>
+size_t count_prefix(const Set& set, std::string_view prefix) {
+    size_t count = 0;
+    auto last = set.end();
+    for (auto it = set.lower_bound(prefix);
+         it != last && (*it).substr(0, prefix.size()) == prefix; ++it)
+        ++count;
+    return count;
+}
+
+// Prints the string argument of a call, or NULL.
+void print_argument(const char* value) {
+    if (value != nullptr)
+        std::cerr << "\"" << value << "\"";
+    else
+        std::cerr << "NULL";
+}
+
+// Sets with more elements together than this are merged in parallel, by at
+// most max_merge_threads threads. Smaller ones are not worth starting the
+// threads for.
+constexpr size_t parallel_merge_size{size_t{1} << 18};
+constexpr unsigned max_merge_threads{8};
+
+unsigned merge_thread_count(size_t size1, size_t size2) {
+    if (size1 + size2 < parallel_merge_size)
+        return 1;
+    // Zero if the number of the cores is not known.
+    auto cores = std::thread::hardware_concurrency();
+    return std::clamp(cores, 1U, max_merge_threads);
+}
+
+using Set_operation = Strset (*)(const Strset&, const Strset&, unsigned);
+
+// Returns the tree of the set. The table of a mapped set is read into
+// [materialized] first.
+const Strset& tree_of(Set_view set, Strset& materialized) {
+    if (set.table != nullptr) {
+        set.table->to_tree(materialized);
+        return materialized;
+    }
+    return set.tree != nullptr ? *set.tree : empty_set();
+}
+
+// Creates the set of the result of the operation [result_name] on the sets
+// id1 and id2, as the function [name] of the API. Non-existing sets are
+// treated as empty, as in strset_comp. The operands are only read, so the
+// 42 Set may be one of them. The merge needs the trees of both sets, so the
+// mapped ones are read whole, which takes no longer than the merge.
+unsigned long create_from_pair(const char* name, const char* result_name,
+                               unsigned long id1, unsigned long id2,
+                               Set_operation operation) {
+    if (debug)
+        std::cerr << name << "(" << id1 << ", " << id2 << ")\n";
+
+    Strset result;
+    bool set1_missing;
+    bool set2_missing;
+    {
+        auto& shard1 = get_shard(id1);
+        auto& shard2 = get_shard(id2);
+        auto locks = lock_for_reading(shard1, shard2);
+
+        auto view1 = shard1.view(id1);
+        set1_missing = view1.missing();
+        auto view2 = shard2.view(id2);
+        set2_missing = view2.missing();
+
+        Strset materialized1;
+        Strset materialized2;
+        const Strset& set1{tree_of(view1, materialized1)};
+        const Strset& set2{tree_of(view2, materialized2)};
+        result = operation(set1, set2,
+                           merge_thread_count(set1.size(), set2.size()));
+    }
+    auto retval = add_set(std::move(result));
+
+    if (debug) {
+        auto name1 = set_name(id1);
+        auto name2 = set_name(id2);
+        std::cerr << name << ": set " << retval << " created as the "
+                  << result_name << " of " << name1 << " and " << name2
+                  << "\n";
+
+        if (set1_missing)
+            std::cerr << name << ": set " << id1 << " does not exist\n";
+        if (set2_missing)
+            std::cerr << name << ": set " << id2 << " does not exist\n";
+    }
+
+    return retval;
+}
+
+// The value of a batch and its position in the batch.
+using Batch_entry = std::pair<std::string_view, size_t>;
+
+// Returns the values of the batch which are not NULL.
+std::vector<Batch_entry> make_batch(const char* const* values, size_t n) {
+    std::vector<Batch_entry> batch;
+    batch.reserve(n);
+    for (size_t i = 0; i < n; ++i) {
+        if (values[i] != nullptr)
+            batch.emplace_back(values[i], i);
+    }
+    return batch;
+}
+
+// Orders the batch by the values, and the equal ones by their positions, if
+// it is big compared to the set. Then the batch goes through the tree from
+// the left to the right and touches most of its nodes, so visiting them in
+// order pays for the sorting. A smaller batch touches a different path for
+// nearly every value anyway. The order of the equal values is kept, so a
+// repeated value is handled as by the single calls one after another.
+void order_batch(std::vector<Batch_entry>& batch, size_t set_size) {
+    if (batch.size() * 4 >= set_size)
+        std::sort(batch.begin(), batch.end());
+}
+
+// Prints the call of the batch function [name] as the single calls do.
+void print_batch_call(const char* name, unsigned long id,
+                      const char* const* values, size_t n) {
+    std::cerr << name << "(" << id << ", ";
+    if (values == nullptr) {
+        std::cerr << "NULL";
+    }
+    else {
+        std::cerr << "{";
+        for (size_t i = 0; i < n; ++i) {
+            if (i != 0)
+                std::cerr << ", ";
+            if (values[i] != nullptr)
+                std::cerr << "\"" << values[i] << "\"";
+            else
+                std::cerr << "NULL";
+        }
+        std::cerr << "}";
+    }
+    std::cerr << ", " << n << ")\n";
 }
 }  // namespace
 
@@ -39,8 +495,12 @@ extern "C" {
 #endif
 
 unsigned long strset_new() {
-    int retval = get_and_increment_next_free_id();
-    get_strsets_map().insert({retval, Strset()});
+    auto retval = get_and_increment_next_free_id();
+    {
+        auto& shard = get_shard(retval);
+        Write_lock lock{shard.mutex};
+        shard.create(retval);
+    }
 
     if (debug) {
         std::cerr << "strset_new()\n"
@@ -50,6 +510,17 @@ unsigned long strset_new() {
     return retval;
 }
 
+unsigned long strset_new_interned() {
+    auto retval = add_set(Strset{Strset::Storage::interned});
+
+    if (debug) {
+        std::cerr << "strset_new_interned()\n"
+                  << "strset_new_interned: set " << retval << " created\n";
+    }
+
+    return retval;
+}
+
 void strset_delete(unsigned long id) {
     if (debug)
         std::cerr << "strset_delete(" << id << ")\n";
@@ -61,7 +532,12 @@ void strset_delete(unsigned long id) {
         return;
     }
 
-    auto elements_erased = get_strsets_map().erase(id);
+    auto& shard = get_shard(id);
+    Write_lock lock{shard.mutex};
+    auto elements_erased = shard.erase(id);
+    lock.unlock();
+    if (elements_erased)
+        free_id(id);
     if (debug)
         std::cerr << "strset_delete: set " << id
                   << (elements_erased ? " deleted\n" : " does not exist\n");
@@ -72,9 +548,12 @@ size_t strset_size(unsigned long id) {
     if (debug)
         std::cerr << "strset_size(" << id << ")\n";
 
-    auto find = get_strsets_map().find(id);
-    if (find != get_strsets_map().end()) {
-        auto retval = find->second.size();
+    auto& shard = get_shard(id);
+    Read_lock lock{shard.mutex};
+    auto set = shard.view(id);
+    if (!set.missing()) {
+        auto retval = set.size();
+        lock.unlock();
 
         if (debug) {
             std::cerr << "strset_size: ";
@@ -88,6 +567,7 @@ size_t strset_size(unsigned long id) {
         return retval;
     }
     else {
+        lock.unlock();
         if (debug)
             std::cerr << "strset_size: set " << id << " does not exist\n";
 
@@ -119,17 +599,24 @@ void strset_insert(unsigned long id, const char* value) {
         return;
     }
 
-    auto find = get_strsets_map().find(id);
-    if (find != get_strsets_map().end()) {
-        auto insert_suceeded = find->second.emplace(value).second;
+    auto& shard = get_shard(id);
+    Write_lock lock{shard.mutex};
+    auto* find = shard.find(id);
+    if (find != nullptr) {
+        auto insert_suceeded = find->insert(value);
+        lock.unlock();
         if (debug)
             std::cerr << "strset_insert: set " << id << ", element \"" << value
                        << (insert_suceeded ? "\" inserted\n"
                                            : "\" was already present\n");
 
     }
-    else if (debug) {
-        std::cerr << "strset_insert: set " << id << " does not exist\n";
+    else {
+        bool read_only = shard.read_only(id);
+        lock.unlock();
+        if (debug)
+            std::cerr << "strset_insert: set " << id
+                      << (read_only ? " is read-only\n" : " does not exist\n");
     }
 }
 
@@ -151,10 +638,12 @@ void strset_remove(unsigned long id, const char* value) {
         return;
     }
 
-    auto find = get_strsets_map().find(id);
-    if (find != get_strsets_map().end()) {
-        auto erase_str = std::string(value);
-        auto elements_removed = find->second.erase(erase_str);
+    auto& shard = get_shard(id);
+    Write_lock lock{shard.mutex};
+    auto* find = shard.find(id);
+    if (find != nullptr) {
+        auto elements_removed = find->erase(value);
+        lock.unlock();
 
         if (debug) {
             if (elements_removed) {
@@ -168,6 +657,12 @@ void strset_remove(unsigned long id, const char* value) {
             }
         }
     }
+    else {
+        bool read_only = shard.read_only(id);
+        lock.unlock();
+        if (debug && read_only)
+            std::cerr << "strset_remove: set " << id << " is read-only\n";
+    }
 }
 
 int strset_test(unsigned long id, const char* value) {
@@ -181,15 +676,16 @@ int strset_test(unsigned long id, const char* value) {
         return 0;
     }
 
-    auto test_str = std::string(value);
-    auto find = get_strsets_map().find(id);
+    auto& shard = get_shard(id);
+    Read_lock lock{shard.mutex};
+    auto set = shard.view(id);
 
-    // If the set was found, we search for the value.
-    if (find != get_strsets_map().end()) {
-        auto set_ref = find->second;
-        auto set_find = set_ref.find(test_str);
-
-        auto retval = set_find == set_ref.end() ? 0 : 1;
+    // If the set was found, we search for the value in place: the tree or
+    // the table takes the string_view of it, so nothing is copied or
+    // allocated.
+    if (!set.missing()) {
+        auto retval = set.contains(value) ? 1 : 0;
+        lock.unlock();
 
         if (debug) {
             std::cerr << "strset_test: ";
@@ -203,6 +699,7 @@ int strset_test(unsigned long id, const char* value) {
 
         return retval;
     }
+    lock.unlock();
 
     if (debug)
         std::cerr << "strset_test: set " << id << " does not exist\n";
@@ -220,37 +717,47 @@ void strset_clear(unsigned long id) {
         return;
     }
 
-    auto find = get_strsets_map().find(id);
-    if (find != get_strsets_map().end()) {
-        find->second.clear();
+    auto& shard = get_shard(id);
+    Write_lock lock{shard.mutex};
+    auto* find = shard.find(id);
+    if (find != nullptr) {
+        find->clear();
     }
+    bool read_only = shard.read_only(id);
+    lock.unlock();
 
     if (debug)
-        std::cerr << "strset_clear: set " << id << " cleared\n";
+        std::cerr << "strset_clear: set " << id
+                  << (read_only ? " is read-only\n" : " cleared\n");
 }
 
 int strset_comp(unsigned long id1, unsigned long id2) {
     if (debug)
         std::cerr << "strset_comp(" << id1 << ", " << id2 << ")\n";
 
-    // We create a dummy empty and use for all non-existing ids, so that it is
-    // treated the same as if it was empty. I made it static so that it is only
-    // initialized once and we dont waste cycles every time we compare two
-    // strsets.
-    static Strset empty_set{};
-
-    auto find1 = get_strsets_map().find(id1);
-    auto set1_missing = (find1 == get_strsets_map().end());
+    int retval;
+    bool set1_missing;
+    bool set2_missing;
+    {
+        auto& shard1 = get_shard(id1);
+        auto& shard2 = get_shard(id2);
+        auto locks = lock_for_reading(shard1, shard2);
 
-    auto find2 = get_strsets_map().find(id2);
-    auto set2_missing = (find2 == get_strsets_map().end());
+        auto set1 = shard1.view(id1);
+        set1_missing = set1.missing();
 
-    Strset& set1{ set1_missing ? empty_set : (*find1).second };
-    Strset& set2{ set2_missing ? empty_set : (*find2).second };
+        auto set2 = shard2.view(id2);
+        set2_missing = set2.missing();
 
-    // This looks naive, because we traverse the containter twice, but GCC
-    // somehow is able to optimize this perfectly.
-    auto retval = (set1 < set2 ? -1 : (set2 < set1 ? 1 : 0));
+        // A single pass over both sets, which stops at the first difference.
+        // A set is equal to itself without looking at its elements.
+        retval = visit(set1, set2, [](const auto& lhs, const auto& rhs) {
+            if (static_cast<const void*>(&lhs)
+                == static_cast<const void*>(&rhs))
+                return 0;
+            return jnp1::compare(lhs, rhs);
+        });
+    }
 
     if (debug) {
         std::cerr << "strset_comp: result of comparing ";
@@ -274,6 +781,610 @@ int strset_comp(unsigned long id1, unsigned long id2) {
     return retval;
 }
 
+void strset_insert_many(unsigned long id, const char* const* values,
+                        size_t n) {
+    if (debug)
+        print_batch_call("strset_insert_many", id, values, n);
+
+    if (id == strset42()) {
+        if (debug)
+            std::cerr << "strset_insert_many: attempt to insert into the 42 "
+                         "Set\n";
+        return;
+    }
+
+    if (values == nullptr) {
+        if (debug)
+            std::cerr << "strset_insert_many: invalid values (NULL)\n";
+        return;
+    }
+
+    auto batch = make_batch(values, n);
+    std::vector<char> inserted(debug ? n : 0);
+    auto& shard = get_shard(id);
+    Write_lock lock{shard.mutex};
+    auto* find = shard.find(id);
+    if (find == nullptr) {
+        bool read_only = shard.read_only(id);
+        lock.unlock();
+        if (debug)
+            std::cerr << "strset_insert_many: set " << id
+                      << (read_only ? " is read-only\n"
+                                    : " does not exist\n");
+        return;
+    }
+    order_batch(batch, find->size() + batch.size());
+    for (auto& [value, position] : batch) {
+        auto insert_suceeded = find->insert(value);
+        if (debug)
+            inserted[position] = insert_suceeded;
+    }
+    lock.unlock();
+
+    if (debug) {
+        for (size_t i = 0; i < n; ++i) {
+            if (values[i] == nullptr)
+                std::cerr << "strset_insert_many: invalid value (NULL)\n";
+            else
+                std::cerr << "strset_insert_many: set " << id
+                          << ", element \"" << values[i]
+                          << (inserted[i] ? "\" inserted\n"
+                                          : "\" was already present\n");
+        }
+    }
+}
+
+void strset_remove_many(unsigned long id, const char* const* values,
+                        size_t n) {
+    if (debug)
+        print_batch_call("strset_remove_many", id, values, n);
+
+    if (id == strset42()) {
+        if (debug)
+            std::cerr << "strset_remove_many: attempt to remove from the 42 "
+                         "Set\n";
+        return;
+    }
+
+    if (values == nullptr) {
+        if (debug)
+            std::cerr << "strset_remove_many: invalid values (NULL)\n";
+        return;
+    }
+
+    auto batch = make_batch(values, n);
+    std::vector<char> removed(debug ? n : 0);
+    auto& shard = get_shard(id);
+    Write_lock lock{shard.mutex};
+    auto* find = shard.find(id);
+    if (find == nullptr) {
+        bool read_only = shard.read_only(id);
+        lock.unlock();
+        if (debug)
+            std::cerr << "strset_remove_many: set " << id
+                      << (read_only ? " is read-only\n"
+                                    : " does not exist\n");
+        return;
+    }
+    order_batch(batch, find->size());
+    for (auto& [value, position] : batch) {
+        auto elements_removed = find->erase(value);
+        if (debug)
+            removed[position] = elements_removed;
+    }
+    lock.unlock();
+
+    if (debug) {
+        for (size_t i = 0; i < n; ++i) {
+            if (values[i] == nullptr) {
+                std::cerr << "strset_remove_many: invalid value (NULL)\n";
+            }
+            else if (removed[i]) {
+                std::cerr << "strset_remove_many: set " << id
+                          << ", element \"" << values[i] << "\" removed\n";
+            }
+            else {
+                std::cerr << "strset_remove_many: set " << id
+                          << " does not contain the element \"" << values[i]
+                          << "\"\n";
+            }
+        }
+    }
+}
+
+void strset_test_many(unsigned long id, const char* const* values, size_t n,
+                      int* results) {
+    if (debug)
+        print_batch_call("strset_test_many", id, values, n);
+
+    if (values == nullptr || results == nullptr) {
+        if (debug)
+            std::cerr << "strset_test_many: invalid "
+                      << (values == nullptr ? "values" : "results")
+                      << " (NULL)\n";
+        return;
+    }
+
+    std::fill(results, results + n, 0);
+    auto batch = make_batch(values, n);
+    auto& shard = get_shard(id);
+    Read_lock lock{shard.mutex};
+    auto set = shard.view(id);
+    if (set.missing()) {
+        lock.unlock();
+        if (debug)
+            std::cerr << "strset_test_many: set " << id << " does not exist\n";
+        return;
+    }
+    order_batch(batch, set.size());
+    for (auto& [value, position] : batch)
+        results[position] = set.contains(value) ? 1 : 0;
+    lock.unlock();
+
+    if (debug) {
+        for (size_t i = 0; i < n; ++i) {
+            if (values[i] == nullptr) {
+                std::cerr << "strset_test_many: invalid value (NULL)\n";
+                continue;
+            }
+            std::cerr << "strset_test_many: ";
+            if (id == strset42())
+                std::cerr << "the 42 Set";
+            else
+                std::cerr << "set " << id;
+            std::cerr << (results[i] == 0 ? " does not contain "
+                                          : " contains ")
+                      << "the element \"" << values[i] << "\"\n";
+        }
+    }
+}
+
+unsigned long strset_clone(unsigned long id) {
+    if (debug)
+        std::cerr << "strset_clone(" << id << ")\n";
+
+    // The clone shares the nodes of the tree with the set, so this takes a
+    // constant time, and the nodes are copied when either set changes them.
+    // The clone of a mapped set is mapped from the same file.
+    Strset clone;
+    Table_ptr table;
+    bool set_missing;
+    {
+        auto& shard = get_shard(id);
+        Read_lock lock{shard.mutex};
+        auto* slot = shard.find_slot(id);
+        set_missing = (slot == nullptr);
+        if (!set_missing) {
+            clone = slot->strset;
+            table = slot->table;
+        }
+    }
+    auto retval = add_set(std::move(clone), std::move(table));
+
+    if (debug) {
+        auto name = set_name(id);
+        std::cerr << "strset_clone: set " << retval
+                  << " created as a clone of " << name << "\n";
+        if (set_missing)
+            std::cerr << "strset_clone: set " << id << " does not exist\n";
+    }
+
+    return retval;
+}
+
+unsigned long strset_union(unsigned long id1, unsigned long id2) {
+    return create_from_pair("strset_union", "union", id1, id2,
+                            jnp1::set_union);
+}
+
+unsigned long strset_intersection(unsigned long id1, unsigned long id2) {
+    return create_from_pair("strset_intersection", "intersection", id1, id2,
+                            jnp1::set_intersection);
+}
+
+unsigned long strset_difference(unsigned long id1, unsigned long id2) {
+    return create_from_pair("strset_difference", "difference", id1, id2,
+                            jnp1::set_difference);
+}
+
+int strset_equal(unsigned long id1, unsigned long id2) {
+    if (debug)
+        std::cerr << "strset_equal(" << id1 << ", " << id2 << ")\n";
+
+    int retval;
+    bool set1_missing;
+    bool set2_missing;
+    {
+        auto& shard1 = get_shard(id1);
+        auto& shard2 = get_shard(id2);
+        auto locks = lock_for_reading(shard1, shard2);
+
+        auto set1 = shard1.view(id1);
+        set1_missing = set1.missing();
+        auto set2 = shard2.view(id2);
+        set2_missing = set2.missing();
+
+        retval = visit(set1, set2, [](const auto& lhs, const auto& rhs) {
+            return jnp1::equal(lhs, rhs) ? 1 : 0;
+        });
+    }
+
+    if (debug) {
+        auto name1 = set_name(id1);
+        auto name2 = set_name(id2);
+        std::cerr << "strset_equal: " << name1 << " and " << name2
+                  << (retval == 1 ? " are equal\n" : " are not equal\n");
+
+        if (set1_missing)
+            std::cerr << "strset_equal: set " << id1 << " does not exist\n";
+        if (set2_missing)
+            std::cerr << "strset_equal: set " << id2 << " does not exist\n";
+    }
+
+    return retval;
+}
+
+int strset_is_subset(unsigned long id1, unsigned long id2) {
+    if (debug)
+        std::cerr << "strset_is_subset(" << id1 << ", " << id2 << ")\n";
+
+    int retval;
+    bool set1_missing;
+    bool set2_missing;
+    {
+        auto& shard1 = get_shard(id1);
+        auto& shard2 = get_shard(id2);
+        auto locks = lock_for_reading(shard1, shard2);
+
+        auto set1 = shard1.view(id1);
+        set1_missing = set1.missing();
+        auto set2 = shard2.view(id2);
+        set2_missing = set2.missing();
+
+        retval = visit(set1, set2, [](const auto& lhs, const auto& rhs) {
+            return jnp1::is_subset(lhs, rhs) ? 1 : 0;
+        });
+    }
+
+    if (debug) {
+        auto name1 = set_name(id1);
+        auto name2 = set_name(id2);
+        std::cerr << "strset_is_subset: " << name1
+                  << (retval == 1 ? " is" : " is not") << " a subset of "
+                  << name2 << "\n";
+
+        if (set1_missing)
+            std::cerr << "strset_is_subset: set " << id1
+                      << " does not exist\n";
+        if (set2_missing)
+            std::cerr << "strset_is_subset: set " << id2
+                      << " does not exist\n";
+    }
+
+    return retval;
+}
+
+int strset_save(unsigned long id, const char* path) {
+    if (debug) {
+        std::cerr << "strset_save(" << id << ", ";
+        if (path != nullptr)
+            std::cerr << "\"" << path << "\"";
+        else
+            std::cerr << "NULL";
+        std::cerr << ")\n";
+    }
+
+    if (path == nullptr) {
+        if (debug)
+            std::cerr << "strset_save: invalid path (NULL)\n";
+        return 0;
+    }
+
+    // The set is written from its copy, which takes a constant time, so
+    // the lock is not held while the file is written.
+    Strset strset;
+    Table_ptr table;
+    bool set_missing;
+    {
+        auto& shard = get_shard(id);
+        Read_lock lock{shard.mutex};
+        auto* slot = shard.find_slot(id);
+        set_missing = (slot == nullptr);
+        if (!set_missing) {
+            strset = slot->strset;
+            table = slot->table;
+        }
+    }
+    if (set_missing) {
+        if (debug)
+            std::cerr << "strset_save: set " << id << " does not exist\n";
+        return 0;
+    }
+
+    bool saved = table != nullptr ? table->save(path)
+                                  : Strset_table::save(strset, path);
+
+    if (debug) {
+        auto name = set_name(id);
+        std::cerr << "strset_save: " << name
+                  << (saved ? " saved to \"" : " could not be saved to \"")
+                  << path << "\"\n";
+    }
+
+    return saved ? 1 : 0;
+}
+
+unsigned long strset_load(const char* path) {
+    if (debug) {
+        std::cerr << "strset_load(";
+        if (path != nullptr)
+            std::cerr << "\"" << path << "\"";
+        else
+            std::cerr << "NULL";
+        std::cerr << ")\n";
+    }
+
+    if (path == nullptr) {
+        if (debug)
+            std::cerr << "strset_load: invalid path (NULL)\n";
+        return no_id;
+    }
+
+    // The strings are read from the mapped file straight into a new tree,
+    // which is built at once, without inserting them one by one.
+    Strset strset;
+    auto table = Strset_table::open(path);
+    if (table == nullptr || !table->to_tree(strset)) {
+        if (debug)
+            std::cerr << "strset_load: \"" << path
+                      << "\" could not be loaded\n";
+        return no_id;
+    }
+    table.reset();
+    auto retval = add_set(std::move(strset));
+
+    if (debug)
+        std::cerr << "strset_load: set " << retval << " loaded from \""
+                  << path << "\"\n";
+
+    return retval;
+}
+
+unsigned long strset_open_mapped(const char* path) {
+    if (debug) {
+        std::cerr << "strset_open_mapped(";
+        if (path != nullptr)
+            std::cerr << "\"" << path << "\"";
+        else
+            std::cerr << "NULL";
+        std::cerr << ")\n";
+    }
+
+    if (path == nullptr) {
+        if (debug)
+            std::cerr << "strset_open_mapped: invalid path (NULL)\n";
+        return no_id;
+    }
+
+    auto table = Strset_table::open(path);
+    if (table == nullptr) {
+        if (debug)
+            std::cerr << "strset_open_mapped: \"" << path
+                      << "\" could not be mapped\n";
+        return no_id;
+    }
+    auto retval = add_set(Strset{}, std::move(table));
+
+    if (debug)
+        std::cerr << "strset_open_mapped: set " << retval
+                  << " mapped from \"" << path << "\"\n";
+
+    return retval;
+}
+
+unsigned long strset_iter_begin(unsigned long id) {
+    if (debug)
+        std::cerr << "strset_iter_begin(" << id << ")\n";
+
+    bool set_missing;
+    {
+        auto& shard = get_shard(id);
+        Read_lock lock{shard.mutex};
+        set_missing = shard.view(id).missing();
+    }
+    if (set_missing) {
+        if (debug)
+            std::cerr << "strset_iter_begin: set " << id
+                      << " does not exist\n";
+        return no_id;
+    }
+
+    auto cursor = std::make_shared<Cursor>();
+    cursor->id = id;
+    unsigned long retval;
+    {
+        auto& cursors = get_cursors();
+        std::lock_guard<std::mutex> lock{cursors.mutex};
+        retval = cursors.next_id++;
+        cursors.cursors.emplace(retval, std::move(cursor));
+    }
+
+    if (debug) {
+        auto name = set_name(id);
+        std::cerr << "strset_iter_begin: cursor " << retval
+                  << " created for " << name << "\n";
+    }
+
+    return retval;
+}
+
+int strset_iter_next(unsigned long iter, const char** value) {
+    if (debug)
+        std::cerr << "strset_iter_next(" << iter << ")\n";
+
+    if (value == nullptr) {
+        if (debug)
+            std::cerr << "strset_iter_next: invalid value (NULL)\n";
+        return -1;
+    }
+    *value = nullptr;
+
+    auto cursor = find_cursor(iter);
+    if (cursor == nullptr) {
+        if (debug)
+            std::cerr << "strset_iter_next: cursor " << iter
+                      << " does not exist\n";
+        return -1;
+    }
+
+    std::lock_guard<std::mutex> cursor_lock{cursor->mutex};
+    int retval;
+    {
+        auto& shard = get_shard(cursor->id);
+        Read_lock lock{shard.mutex};
+        auto set = shard.view(cursor->id);
+        if (set.missing())
+            retval = -1;
+        else
+            retval = advance(*cursor, set) ? 1 : 0;
+    }
+    if (retval == 1)
+        *value = cursor->value.c_str();
+
+    if (debug) {
+        auto name = set_name(cursor->id);
+        if (retval == 1)
+            std::cerr << "strset_iter_next: cursor " << iter << ", element \""
+                      << cursor->value << "\"\n";
+        else if (retval == 0)
+            std::cerr << "strset_iter_next: cursor " << iter
+                      << " reached the end of " << name << "\n";
+        else
+            std::cerr << "strset_iter_next: " << name << " of cursor " << iter
+                      << " does not exist\n";
+    }
+
+    return retval;
+}
+
+void strset_iter_end(unsigned long iter) {
+    if (debug)
+        std::cerr << "strset_iter_end(" << iter << ")\n";
+
+    // A call of strset_iter_next() on the cursor in another thread keeps it
+    // until it returns.
+    bool cursor_ended;
+    {
+        auto& cursors = get_cursors();
+        std::lock_guard<std::mutex> lock{cursors.mutex};
+        cursor_ended = cursors.cursors.erase(iter) == 1;
+    }
+
+    if (debug)
+        std::cerr << "strset_iter_end: cursor " << iter
+                  << (cursor_ended ? " ended\n" : " does not exist\n");
+}
+
+size_t strset_prefix_count(unsigned long id, const char* prefix) {
+    if (debug) {
+        std::cerr << "strset_prefix_count(" << id << ", ";
+        print_argument(prefix);
+        std::cerr << ")\n";
+    }
+
+    if (prefix == nullptr) {
+        if (debug)
+            std::cerr << "strset_prefix_count: invalid prefix (NULL)\n";
+        return 0;
+    }
+
+    size_t retval = 0;
+    bool set_missing;
+    {
+        auto& shard = get_shard(id);
+        Read_lock lock{shard.mutex};
+        auto set = shard.view(id);
+        set_missing = set.missing();
+        if (set.table != nullptr)
+            retval = count_prefix(*set.table, prefix);
+        else if (set.tree != nullptr)
+            retval = count_prefix(*set.tree, prefix);
+    }
+
+    if (debug) {
+        if (set_missing) {
+            std::cerr << "strset_prefix_count: set " << id
+                      << " does not exist\n";
+        }
+        else {
+            auto name = set_name(id);
+            std::cerr << "strset_prefix_count: " << name << " contains "
+                      << retval << " element(s) with the prefix \"" << prefix
+                      << "\"\n";
+        }
+    }
+
+    return retval;
+}
+
+size_t strset_range(unsigned long id, const char* lo, const char* hi,
+                    int (*callback)(const char* value, void* context),
+                    void* context) {
+    if (debug) {
+        std::cerr << "strset_range(" << id << ", ";
+        print_argument(lo);
+        std::cerr << ", ";
+        print_argument(hi);
+        std::cerr << ")\n";
+    }
+
+    if (callback == nullptr) {
+        if (debug)
+            std::cerr << "strset_range: invalid callback (NULL)\n";
+        return 0;
+    }
+
+    // The elements are found as by a cursor, and the callback is called
+    // without the lock, so it may use the set, and change it too.
+    Cursor cursor;
+    cursor.id = id;
+    if (lo != nullptr)
+        cursor.value = lo;
+    size_t retval = 0;
+    bool set_missing = false;
+    while (true) {
+        bool found;
+        {
+            auto& shard = get_shard(id);
+            Read_lock lock{shard.mutex};
+            auto set = shard.view(id);
+            if (set.missing()) {
+                set_missing = !cursor.positioned;
+                break;
+            }
+            found = advance(cursor, set);
+        }
+        if (!found || (hi != nullptr && cursor.value >= hi))
+            break;
+        ++retval;
+        if (callback(cursor.value.c_str(), context) != 0)
+            break;
+    }
+
+    if (debug) {
+        if (set_missing) {
+            std::cerr << "strset_range: set " << id << " does not exist\n";
+        }
+        else {
+            auto name = set_name(id);
+            std::cerr << "strset_range: " << retval << " element(s) of "
+                      << name << " passed to the callback\n";
+        }
+    }
+
+    return retval;
+}
+
 #ifdef __cplusplus
 }  // extern "C"
 }  // namespace jnp1
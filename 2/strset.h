@@ -18,6 +18,14 @@ extern "C" {
 // Tworzy nowy zbiór i zwraca jego identyfikator.
 unsigned long strset_new();
 
+// Tworzy nowy zbiór i zwraca jego identyfikator. Napisy dłuższe niż 8 znaków
+// są w nim przechowywane we wspólnej puli, raz dla wszystkich takich zbiorów,
+// więc zajmowana pamięć zależy od liczby różnych napisów, a nie elementów.
+// Poza tym zbiór działa jak utworzony przez strset_new(). Zbiory utworzone
+// przez strset_clone, strset_union, strset_intersection i strset_difference
+// przechowują napisy tak, jak zbiór id albo id1.
+unsigned long strset_new_interned();
+
 // Jeżeli istnieje zbiór o identyfikatorze id, usuwa go, a w przeciwnym
 // przypadku nie robi nic.
 void strset_delete(unsigned long id);
@@ -54,6 +62,105 @@ void strset_clear(unsigned long id);
 // jako równy zbiorowi pustemu.
 int strset_comp(unsigned long id1, unsigned long id2);
 
+// Zwraca 1, jeżeli zbiory o identyfikatorach id1 i id2 są równe, a w przeciwnym
+// przypadku 0. Działa jak strset_comp(id1, id2) == 0, ale zbiory o różnych
+// rozmiarach lub skrótach rozróżnia w czasie stałym. Jeżeli zbiór o którymś
+// z identyfikatorów nie istnieje, to jest traktowany jako zbiór pusty.
+int strset_equal(unsigned long id1, unsigned long id2);
+
+// Działa jak wywołania strset_insert(id, values[i]) kolejno dla i = 0, ...,
+// n - 1, ale wyszukuje zbiór tylko raz. Jeżeli values jest NULL, nie robi nic.
+void strset_insert_many(unsigned long id, const char* const* values, size_t n);
+
+// Działa jak wywołania strset_remove(id, values[i]) kolejno dla i = 0, ...,
+// n - 1, ale wyszukuje zbiór tylko raz. Jeżeli values jest NULL, nie robi nic.
+void strset_remove_many(unsigned long id, const char* const* values, size_t n);
+
+// Zapisuje w results[i] wynik strset_test(id, values[i]) dla i = 0, ..., n - 1,
+// wyszukując zbiór tylko raz. Jeżeli values lub results jest NULL, nie robi
+// nic.
+void strset_test_many(unsigned long id, const char* const* values, size_t n,
+                      int* results);
+
+// Tworzy nowy zbiór o tych samych elementach, co zbiór o identyfikatorze id,
+// i zwraca jego identyfikator. Działa w czasie stałym: oba zbiory dzielą
+// pamięć, dopóki któryś z nich się nie zmieni. Jeżeli zbiór o identyfikatorze
+// id nie istnieje, to tworzy zbiór pusty.
+unsigned long strset_clone(unsigned long id);
+
+// Tworzy nowy zbiór, będący sumą zbiorów o identyfikatorach id1 i id2, i zwraca
+// jego identyfikator. Jeżeli zbiór o którymś z identyfikatorów nie istnieje, to
+// jest traktowany jako zbiór pusty. Tak samo działają strset_intersection
+// i strset_difference.
+unsigned long strset_union(unsigned long id1, unsigned long id2);
+
+// Tworzy nowy zbiór, będący częścią wspólną zbiorów o identyfikatorach id1
+// i id2, i zwraca jego identyfikator.
+unsigned long strset_intersection(unsigned long id1, unsigned long id2);
+
+// Tworzy nowy zbiór elementów zbioru o identyfikatorze id1, które nie należą
+// do zbioru o identyfikatorze id2, i zwraca jego identyfikator.
+unsigned long strset_difference(unsigned long id1, unsigned long id2);
+
+// Zwraca 1, jeżeli każdy element zbioru o identyfikatorze id1 należy do zbioru
+// o identyfikatorze id2, a w przeciwnym przypadku 0. Jeżeli zbiór o którymś
+// z identyfikatorów nie istnieje, to jest traktowany jako zbiór pusty.
+int strset_is_subset(unsigned long id1, unsigned long id2);
+
+// Zapisuje zbiór o identyfikatorze id w pliku path, w postaci, którą
+// odczytują strset_load i strset_open_mapped. Plik jest zastępowany dopiero
+// po zapisaniu całego zbioru. Zwraca 1, jeżeli zbiór został zapisany, a 0,
+// jeżeli zbiór nie istnieje, path jest NULL lub nie udało się zapisać pliku.
+int strset_save(unsigned long id, const char* path);
+
+// Tworzy nowy zbiór o elementach zapisanych w pliku path przez strset_save
+// i zwraca jego identyfikator. Jeżeli path jest NULL, pliku nie da się
+// odczytać albo jest uszkodzony, to nie tworzy zbioru i zwraca ULONG_MAX,
+// który nie jest identyfikatorem żadnego zbioru.
+unsigned long strset_load(const char* path);
+
+// Działa jak strset_load, ale nie wczytuje elementów, tylko odwzorowuje plik
+// w pamięci, i z niego czyta je strset_test. Takiego zbioru nie można
+// zmieniać: strset_insert, strset_remove, strset_clear, strset_insert_many
+// i strset_remove_many nic dla niego nie robią. Późniejsze zastąpienie pliku
+// przez strset_save nie zmienia zbioru. Uszkodzenie bloków pliku jest
+// wykrywane dopiero przy odczycie elementów, które za nim są pomijane.
+unsigned long strset_open_mapped(const char* path);
+
+// Tworzy kursor, który przechodzi po elementach zbioru o identyfikatorze id
+// w porządku leksykograficznym, i zwraca jego identyfikator. Jeżeli zbiór
+// nie istnieje, to nie tworzy kursora i zwraca ULONG_MAX.
+unsigned long strset_iter_begin(unsigned long id);
+
+// Jeżeli kursor o identyfikatorze iter ma kolejny element, to zapisuje go
+// w *value i zwraca 1. Napis jest ważny do następnego wywołania funkcji dla
+// tego kursora. Jeżeli elementów już nie ma, to zwraca 0. Zmiany zbioru nie
+// unieważniają kursora: zwraca on potem elementy większe od ostatnio
+// zwróconego, w tym dodane po jego utworzeniu. Jeżeli value jest NULL, kursor
+// nie istnieje albo jego zbiór został usunięty, to zwraca -1. Poza pierwszym
+// wywołaniem i wywołaniami po zmianie zbioru działa w czasie stałym.
+int strset_iter_next(unsigned long iter, const char** value);
+
+// Jeżeli istnieje kursor o identyfikatorze iter, usuwa go, a w przeciwnym
+// przypadku nie robi nic.
+void strset_iter_end(unsigned long iter);
+
+// Zwraca liczbę elementów zbioru o identyfikatorze id, które zaczynają się
+// od napisu prefix, w czasie O(log n + k), gdzie k jest tą liczbą. Jeżeli
+// zbiór nie istnieje lub prefix jest NULL, zwraca 0.
+size_t strset_prefix_count(unsigned long id, const char* prefix);
+
+// Wywołuje callback(value, context) kolejno dla elementów value zbioru
+// o identyfikatorze id, które nie są mniejsze od lo i są mniejsze od hi,
+// w porządku leksykograficznym, dopóki callback zwraca 0. Jeżeli lo lub hi
+// jest NULL, to przedział nie jest z tej strony ograniczony. Elementy są
+// znajdowane tak, jak przez kursor, więc callback może zmieniać zbiór. Zwraca
+// liczbę wywołań callback. Jeżeli zbiór nie istnieje lub callback jest NULL,
+// to zwraca 0.
+size_t strset_range(unsigned long id, const char* lo, const char* hi,
+                    int (*callback)(const char* value, void* context),
+                    void* context);
+
 #ifdef __cplusplus
 } // extern "C"
 } // namespace jnp1
@@ -0,0 +1,149 @@
+// Microbenchmark of the query path of the strset API. It fills one big set,
+// and then measures strset_test (on present and missing elements),
+// strset_remove of missing elements, strset_size and strset_test_many,
+// counting the heap allocations made during every measurement. The single
+// queries must not make any, so the benchmark fails if they do. The batches
+// allocate once per batch, for sorting it.
+//
+// Build it with NDEBUG, so that the debug messages are not measured.
+// Usage: ./strset_bench [number of elements]
+// The set has 1000000 elements by default.
+
+#include "strset.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <string>
+#include <vector>
+
+using jnp1::strset_insert;
+using jnp1::strset_new;
+using jnp1::strset_remove;
+using jnp1::strset_size;
+using jnp1::strset_test;
+using jnp1::strset_test_many;
+
+namespace {
+    constexpr size_t batch_size{1024};
+
+    std::atomic<unsigned long> allocation_count{0};
+
+    // Keys of different lengths, so that both the short keys kept in the
+    // tree nodes and the long ones are measured.
+    std::string make_key(unsigned long i) {
+        auto key = std::to_string(i * 2654435761UL % 1000000007UL);
+        if (i % 2 == 0)
+            key += "/some/longer/suffix";
+        return key;
+    }
+
+    struct Result {
+        double ns_per_call;
+        unsigned long allocations;
+    };
+
+    template <typename F>
+    Result measure(size_t calls, F f) {
+        auto allocations_before = allocation_count.load();
+        auto start = std::chrono::steady_clock::now();
+        f();
+        std::chrono::duration<double, std::nano> elapsed{
+            std::chrono::steady_clock::now() - start};
+        return {elapsed.count() / calls,
+                allocation_count.load() - allocations_before};
+    }
+
+    bool report(const char* name, Result result) {
+        std::printf("%-24s %8.1f ns/call %10lu allocation(s)\n", name,
+                    result.ns_per_call, result.allocations);
+        return result.allocations == 0;
+    }
+}
+
+// Not inlined, so that the compiler does not pair malloc with the delete
+// expressions of the benchmark and warn about the mismatch.
+[[gnu::noinline]] void* operator new(size_t size) {
+    allocation_count.fetch_add(1, std::memory_order_relaxed);
+    if (void* pointer = std::malloc(size == 0 ? 1 : size))
+        return pointer;
+    throw std::bad_alloc{};
+}
+
+[[gnu::noinline]] void operator delete(void* pointer) noexcept {
+    std::free(pointer);
+}
+
+[[gnu::noinline]] void operator delete(void* pointer, size_t) noexcept {
+    std::free(pointer);
+}
+
+int main(int argc, char** argv) {
+    size_t count = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 1000000;
+
+    std::vector<const char*> present_values;
+    std::vector<std::string> present;
+    std::vector<std::string> missing;
+    present.reserve(count);
+    missing.reserve(count);
+    for (size_t i = 0; i < count; ++i) {
+        present.push_back(make_key(i));
+        missing.push_back(present.back() + "!");
+    }
+
+    for (auto& key : present)
+        present_values.push_back(key.c_str());
+
+    auto id = strset_new();
+    auto fill = measure(count, [&] {
+        for (auto& key : present)
+            strset_insert(id, key.c_str());
+    });
+    std::printf("%zu element(s)\n", strset_size(id));
+    report("strset_insert", fill);
+
+    bool ok = true;
+    int found = 0;
+    ok &= report("strset_test (present)", measure(count, [&] {
+        for (auto& key : present)
+            found += strset_test(id, key.c_str());
+    }));
+    ok &= report("strset_test (missing)", measure(count, [&] {
+        for (auto& key : missing)
+            found += strset_test(id, key.c_str());
+    }));
+    ok &= report("strset_remove (missing)", measure(count, [&] {
+        for (auto& key : missing)
+            strset_remove(id, key.c_str());
+    }));
+    size_t sizes = 0;
+    ok &= report("strset_size", measure(count, [&] {
+        for (size_t i = 0; i < count; ++i)
+            sizes += strset_size(id);
+    }));
+    int found_in_batches = 0;
+    std::vector<int> results(batch_size);
+    report("strset_test_many", measure(count, [&] {
+        for (size_t i = 0; i < count; i += batch_size) {
+            auto n = std::min(batch_size, count - i);
+            strset_test_many(id, present_values.data() + i, n,
+                             results.data());
+            for (size_t j = 0; j < n; ++j)
+                found_in_batches += results[j];
+        }
+    }));
+
+    if (static_cast<size_t>(found) != count
+        || static_cast<size_t>(found_in_batches) != count
+        || sizes != count * count) {
+        std::printf("wrong results\n");
+        return 1;
+    }
+    if (!ok) {
+        std::printf("the query path allocates\n");
+        return 1;
+    }
+}
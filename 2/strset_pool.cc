@@ -0,0 +1,164 @@
+#include <array>
+#include <cstring>
+#include <functional>
+#include <limits>
+#include <mutex>
+#include <stdexcept>
+#include <unordered_map>
+#include <vector>
+
+#include "strset_pool.h"
+
+using jnp1::String_pool;
+
+std::atomic<String_pool::Entry*> String_pool::chunks[String_pool::max_chunks];
+
+namespace jnp1 {
+
+// The index of the strings, and the free handles. It is in a friend struct,
+// so that it can use the private types of the pool.
+struct String_pool_state {
+    using Entry = String_pool::Entry;
+    using Handle = String_pool::Handle;
+
+    // The strings are split into shards by their hashes, so that the threads
+    // interning different strings do not wait for each other.
+    static constexpr size_t shard_count{64};
+
+    struct alignas(64) Shard {
+        std::mutex mutex;
+        // The keys are the texts of the entries.
+        std::unordered_map<std::string_view, Handle> handles;
+    };
+
+    std::array<Shard, shard_count> shards{};
+
+    std::mutex handles_mutex;
+    std::vector<Handle> free_handles;
+    // Wider than a handle, so that it does not wrap around when all the
+    // handles are used.
+    uint64_t next_handle{0};
+    std::atomic<size_t> size{0};
+
+    static Entry& entry(Handle handle) {
+        return String_pool::chunks[handle / String_pool::chunk_size].load(
+            std::memory_order_acquire)[handle % String_pool::chunk_size];
+    }
+
+    Shard& shard_of(std::string_view text) {
+        return shards[std::hash<std::string_view>{}(text) % shard_count];
+    }
+
+    // Returns the unused entry, allocating its chunk if it is the first one
+    // in the chunk. Throws std::length_error if all the handles are used.
+    Handle allocate() {
+        std::lock_guard<std::mutex> lock{handles_mutex};
+        if (!free_handles.empty()) {
+            auto handle = free_handles.back();
+            free_handles.pop_back();
+            return handle;
+        }
+
+        if (next_handle > std::numeric_limits<Handle>::max())
+            throw std::length_error{"String_pool: out of handles"};
+        auto handle = static_cast<Handle>(next_handle++);
+        auto& chunk = String_pool::chunks[handle / String_pool::chunk_size];
+        if (chunk.load(std::memory_order_relaxed) == nullptr)
+            chunk.store(new Entry[String_pool::chunk_size],
+                        std::memory_order_release);
+        return handle;
+    }
+
+    void free(Handle handle) {
+        std::lock_guard<std::mutex> lock{handles_mutex};
+        free_handles.push_back(handle);
+    }
+};
+
+}  // namespace jnp1
+
+namespace {
+
+using jnp1::String_pool_state;
+
+// Correctly staticly initializes the state of the pool. It is never
+// destroyed, because the sets kept in the static storage release their
+// strings after main() returns.
+String_pool_state& get_state() {
+    static String_pool_state& state{*new String_pool_state{}};
+    return state;
+}
+
+// Takes a reference to the entry, unless the last one was already dropped
+// and the entry is being freed.
+bool add_reference_if_alive(std::atomic<uint32_t>& references) {
+    auto count = references.load(std::memory_order_relaxed);
+    while (count != 0) {
+        if (references.compare_exchange_weak(count, count + 1,
+                                             std::memory_order_acq_rel))
+            return true;
+    }
+    return false;
+}
+
+}  // namespace
+
+String_pool::Handle String_pool::intern(std::string_view text) {
+    if (text.size() > std::numeric_limits<uint32_t>::max())
+        throw std::length_error{"String_pool: string too long"};
+
+    auto& state = get_state();
+    auto& shard = state.shard_of(text);
+    std::lock_guard<std::mutex> lock{shard.mutex};
+    auto found = shard.handles.find(text);
+    if (found != shard.handles.end()) {
+        if (add_reference_if_alive(state.entry(found->second).references))
+            return found->second;
+        // The entry is being freed, by the thread which waits for this lock
+        // now. The new one takes its place in the index.
+        shard.handles.erase(found);
+    }
+
+    auto handle = state.allocate();
+    auto& entry = state.entry(handle);
+    entry.data = new char[text.size()];
+    if (!text.empty())
+        std::memcpy(entry.data, text.data(), text.size());
+    entry.length = static_cast<uint32_t>(text.size());
+    entry.references.store(1, std::memory_order_relaxed);
+    shard.handles.emplace(std::string_view(entry.data, entry.length), handle);
+    state.size.fetch_add(1, std::memory_order_relaxed);
+    return handle;
+}
+
+void String_pool::add_reference(Handle handle) {
+    String_pool_state::entry(handle).references.fetch_add(
+        1, std::memory_order_relaxed);
+}
+
+void String_pool::release(Handle handle) {
+    auto& entry = String_pool_state::entry(handle);
+    if (entry.references.fetch_sub(1, std::memory_order_acq_rel) != 1)
+        return;
+
+    // Nobody can take a reference to the entry now, but intern() may have
+    // replaced it in the index already.
+    auto& state = get_state();
+    auto text = std::string_view(entry.data, entry.length);
+    {
+        auto& shard = state.shard_of(text);
+        std::lock_guard<std::mutex> lock{shard.mutex};
+        auto found = shard.handles.find(text);
+        if (found != shard.handles.end() && found->second == handle)
+            shard.handles.erase(found);
+    }
+    delete[] entry.data;
+    entry.data = nullptr;
+    entry.length = 0;
+    state.size.fetch_sub(1, std::memory_order_relaxed);
+    state.free(handle);
+}
+
+size_t String_pool::size() {
+    return get_state().size.load(std::memory_order_relaxed);
+}
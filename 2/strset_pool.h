@@ -0,0 +1,65 @@
+#ifndef STRSET_POOL_H
+#define STRSET_POOL_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+namespace jnp1 {
+
+// Strings shared by all the interned trees. Every distinct string is kept in
+// the pool once, with the number of the references to it, and is freed when
+// the last reference is dropped. A string is known by its handle, which stays
+// the same as long as there are references to it.
+//
+// All functions may be called from many threads at once.
+class String_pool {
+public:
+    using Handle = uint32_t;
+
+    // Returns the handle of the string, adding it to the pool if it is not
+    // there yet, and takes a reference to it. Throws std::length_error if
+    // the string is longer than 2^32 - 1 characters, or if there are 2^32
+    // distinct strings in the pool already.
+    static Handle intern(std::string_view text);
+
+    // Takes another reference to the string. The caller must already have
+    // one.
+    static void add_reference(Handle handle);
+
+    // Drops a reference to the string.
+    static void release(Handle handle);
+
+    // Returns the string. The caller must have a reference to it. The texts
+    // of the same handle are at the same address, so they are equal if
+    // their data pointers are.
+    static std::string_view text(Handle handle) {
+        const Entry& entry = chunks[handle / chunk_size].load(
+            std::memory_order_acquire)[handle % chunk_size];
+        return std::string_view(entry.data, entry.length);
+    }
+
+    // Number of the distinct strings in the pool.
+    static size_t size();
+
+private:
+    struct Entry {
+        std::atomic<uint32_t> references;
+        uint32_t length;
+        char* data;
+    };
+
+    // Entries are allocated in chunks which never move, so the text of a
+    // handle is found without a lock.
+    static constexpr Handle chunk_size{Handle{1} << 16};
+    static constexpr size_t max_chunks{size_t{1} << 16};
+
+    static std::atomic<Entry*> chunks[max_chunks];
+
+    friend struct String_pool_state;
+};
+
+}  // namespace jnp1
+
+#endif
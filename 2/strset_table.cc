@@ -0,0 +1,486 @@
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "strset_table.h"
+
+using jnp1::Strset_table;
+using jnp1::Strset_tree;
+
+namespace {
+
+constexpr char magic[8]{'S', 'T', 'R', 'S', 'E', 'T', '0', '1'};
+constexpr size_t header_size{32};
+
+uint64_t read_number(const char* data) {
+    uint64_t value = 0;
+    for (int i = 7; i >= 0; --i)
+        value = value << 8 | static_cast<unsigned char>(data[i]);
+    return value;
+}
+
+void append_number(std::string& out, uint64_t value) {
+    for (int i = 0; i < 8; ++i, value >>= 8)
+        out.push_back(static_cast<char>(value & 0xff));
+}
+
+// Reads the varint at the offset, and moves the offset past it. Returns
+// false if it does not end before [end] or does not fit in 64 bits.
+bool read_varint(const char* data, size_t& offset, size_t end,
+                 uint64_t& value) {
+    value = 0;
+    for (int shift = 0; shift < 64 && offset < end; shift += 7) {
+        auto byte = static_cast<unsigned char>(data[offset++]);
+        value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+        if ((byte & 0x80) == 0)
+            return true;
+    }
+    return false;
+}
+
+void append_varint(std::string& out, uint64_t value) {
+    while (value >= 0x80) {
+        out.push_back(static_cast<char>((value & 0x7f) | 0x80));
+        value >>= 7;
+    }
+    out.push_back(static_cast<char>(value));
+}
+
+size_t shared_prefix(std::string_view lhs, std::string_view rhs) {
+    auto length = std::min(lhs.size(), rhs.size());
+    return std::mismatch(lhs.begin(), lhs.begin() + length, rhs.begin())
+               .first
+           - lhs.begin();
+}
+
+// Writes the file through a temporary one, which replaces it when it is
+// complete. [write] writes the table to the stream.
+template <typename Write>
+bool write_file(const char* path, Write write) {
+    static std::atomic<unsigned long> temporary_count{0};
+    auto temporary = std::string(path) + ".tmp" + std::to_string(getpid())
+                     + "." + std::to_string(temporary_count.fetch_add(1));
+    {
+        std::ofstream out{temporary, std::ios::binary | std::ios::trunc};
+        if (out)
+            write(out);
+        out.close();
+        if (!out) {
+            std::remove(temporary.c_str());
+            return false;
+        }
+    }
+    if (std::rename(temporary.c_str(), path) != 0) {
+        std::remove(temporary.c_str());
+        return false;
+    }
+    return true;
+}
+
+// The functions for the pairs of a table and a tree, which go over both
+// sets in order.
+template <typename Lhs, typename Rhs>
+int compare_elements(const Lhs& lhs, const Rhs& rhs) {
+    auto left = lhs.begin();
+    auto left_end = lhs.end();
+    auto right = rhs.begin();
+    auto right_end = rhs.end();
+    for (; left != left_end && right != right_end; ++left, ++right) {
+        int order = (*left).compare(*right);
+        if (order != 0)
+            return order < 0 ? -1 : 1;
+    }
+    if (left != left_end)
+        return 1;
+    if (right != right_end)
+        return -1;
+    return 0;
+}
+
+template <typename Lhs, typename Rhs>
+bool equal_elements(const Lhs& lhs, const Rhs& rhs) {
+    return lhs.size() == rhs.size() && compare_elements(lhs, rhs) == 0;
+}
+
+template <typename Subset, typename Set>
+bool includes_elements(const Subset& subset, const Set& set) {
+    return subset.size() <= set.size()
+           && std::includes(set.begin(), set.end(), subset.begin(),
+                            subset.end());
+}
+
+}  // namespace
+
+std::shared_ptr<const Strset_table> Strset_table::open(const char* path) {
+    int file = ::open(path, O_RDONLY | O_CLOEXEC);
+    if (file < 0)
+        return nullptr;
+    struct stat status;
+    if (fstat(file, &status) != 0 || !S_ISREG(status.st_mode)
+        || static_cast<size_t>(status.st_size) < header_size) {
+        close(file);
+        return nullptr;
+    }
+
+    auto length = static_cast<size_t>(status.st_size);
+    void* mapping = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, file, 0);
+    close(file);
+    if (mapping == MAP_FAILED)
+        return nullptr;
+
+    // The mapping is owned by the table from now on.
+    std::shared_ptr<Strset_table> table{
+        new Strset_table{static_cast<const char*>(mapping), length}};
+    if (!table->read_index())
+        return nullptr;
+    return table;
+}
+
+bool Strset_table::save(const Strset_tree& set, const char* path) {
+    return write_file(path, [&set](std::ostream& out) {
+        auto block_count = (set.size() + block_size - 1) / block_size;
+        std::string index;
+        index.reserve(block_count * 8);
+
+        // The offset of the index is not known yet.
+        out.write(magic, sizeof(magic));
+        std::string header;
+        append_number(header, set.size());
+        append_number(header, block_count);
+        append_number(header, 0);
+        out.write(header.data(), header.size());
+
+        // The strings of the tree stay where they are while it is not
+        // changed, so the previous one is not copied.
+        size_t offset = header_size;
+        size_t position = 0;
+        std::string_view previous;
+        std::string block;
+        for (auto value : set) {
+            if (position % block_size == 0) {
+                out.write(block.data(), block.size());
+                offset += block.size();
+                block.clear();
+                append_number(index, offset);
+                append_varint(block, value.size());
+                block.append(value);
+            }
+            else {
+                auto shared = shared_prefix(previous, value);
+                append_varint(block, shared);
+                append_varint(block, value.size() - shared);
+                block.append(value.substr(shared));
+            }
+            previous = value;
+            ++position;
+        }
+        out.write(block.data(), block.size());
+        offset += block.size();
+        out.write(index.data(), index.size());
+
+        header.clear();
+        append_number(header, offset);
+        out.seekp(header_size - 8);
+        out.write(header.data(), header.size());
+    });
+}
+
+bool Strset_table::save(const char* path) const {
+    return write_file(path, [this](std::ostream& out) {
+        out.write(data, length);
+    });
+}
+
+Strset_table::~Strset_table() {
+    munmap(const_cast<char*>(data), length);
+}
+
+bool Strset_table::contains(std::string_view value) const {
+    auto block = find_block(value);
+    return block != block_count && block_contains(block, value);
+}
+
+Strset_table::const_iterator Strset_table::begin() const {
+    const_iterator result;
+    result.table = this;
+    result.start_block(0);
+    return result;
+}
+
+Strset_table::const_iterator Strset_table::lower_bound(
+    std::string_view value) const {
+    auto block = find_block(value);
+    if (block == block_count) {
+        // The value is less than all the strings, or the table is damaged.
+        std::string_view first;
+        if (block_count > 0 && first_string(0, first) && value < first)
+            return begin();
+        return end();
+    }
+
+    // The first string of the next block is greater than the value, so at
+    // most a block is read.
+    const_iterator result;
+    result.table = this;
+    result.start_block(block);
+    auto last = end();
+    while (result != last && *result < value)
+        ++result;
+    return result;
+}
+
+Strset_table::const_iterator Strset_table::end() const {
+    const_iterator result;
+    result.table = this;
+    result.block = block_count;
+    return result;
+}
+
+bool Strset_table::to_tree(Strset_tree& tree) const {
+    // The strings are decoded one after another into a single buffer, and
+    // the tree is built of them at once.
+    std::string characters;
+    std::vector<size_t> ends;
+    ends.reserve(element_count);
+    auto it = begin();
+    auto last_it = end();
+    bool increasing = true;
+    for (; it != last_it; ++it) {
+        auto value = *it;
+        if (!ends.empty()) {
+            size_t last_begin = ends.size() == 1 ? 0 : ends[ends.size() - 2];
+            std::string_view last(characters.data() + last_begin,
+                                  ends.back() - last_begin);
+            if (value <= last) {
+                increasing = false;
+                break;
+            }
+        }
+        characters.append(value);
+        ends.push_back(characters.size());
+    }
+
+    std::vector<std::string_view> values;
+    values.reserve(ends.size());
+    size_t value_begin = 0;
+    for (auto value_end : ends) {
+        values.emplace_back(characters.data() + value_begin,
+                            value_end - value_begin);
+        value_begin = value_end;
+    }
+    tree = Strset_tree::from_sorted(values);
+    return increasing && !it.damaged();
+}
+
+bool Strset_table::read_index() {
+    if (std::memcmp(data, magic, sizeof(magic)) != 0)
+        return false;
+    element_count = read_number(data + 8);
+    block_count = read_number(data + 16);
+    index_offset = read_number(data + 24);
+
+    // Every string takes at least a byte, and every block at least 8 in the
+    // index.
+    if (element_count > length
+        || block_count != (element_count + block_size - 1) / block_size
+        || index_offset < header_size || index_offset > length
+        || (length - index_offset) / 8 != block_count
+        || (length - index_offset) % 8 != 0)
+        return false;
+
+    // The blocks follow each other, and none of them is empty.
+    size_t previous = header_size;
+    for (size_t block = 0; block < block_count; ++block) {
+        auto offset = block_begin(block);
+        if (block == 0 ? offset != header_size : offset <= previous)
+            return false;
+        if (offset >= index_offset)
+            return false;
+        previous = offset;
+    }
+    return block_count > 0 || index_offset == header_size;
+}
+
+size_t Strset_table::block_begin(size_t block) const {
+    return read_number(data + index_offset + block * 8);
+}
+
+size_t Strset_table::block_end(size_t block) const {
+    return block + 1 < block_count ? block_begin(block + 1) : index_offset;
+}
+
+size_t Strset_table::block_length(size_t block) const {
+    return std::min(block_size, element_count - block * block_size);
+}
+
+size_t Strset_table::find_block(std::string_view value) const {
+    std::string_view first;
+    if (block_count == 0 || !first_string(0, first) || value < first)
+        return block_count;
+
+    size_t low = 0;
+    size_t high = block_count;
+    while (high - low > 1) {
+        auto middle = low + (high - low) / 2;
+        if (!first_string(middle, first))
+            return block_count;
+        if (first <= value)
+            low = middle;
+        else
+            high = middle;
+    }
+    return low;
+}
+
+bool Strset_table::first_string(size_t block,
+                                std::string_view& first) const {
+    auto offset = block_begin(block);
+    auto end = block_end(block);
+    uint64_t first_length;
+    if (!read_varint(data, offset, end, first_length)
+        || first_length > end - offset)
+        return false;
+    first = std::string_view(data + offset, first_length);
+    return true;
+}
+
+// Goes over the block without decoding the strings: it knows how long a
+// prefix the previous string (less than the value) shares with the value.
+// A string which shares more with the previous one is less than the value
+// too, and one which shares less is greater, because the shared prefixes
+// are the longest ones. Only the strings which share exactly as much have
+// their rests compared.
+bool Strset_table::block_contains(size_t block,
+                                  std::string_view value) const {
+    std::string_view first;
+    if (!first_string(block, first))
+        return false;
+    auto offset = static_cast<size_t>(first.data() + first.size() - data);
+    auto end = block_end(block);
+
+    auto matched = shared_prefix(first, value);
+    if (matched == first.size() && matched == value.size())
+        return true;
+    auto previous_length = first.size();
+    auto count = block_length(block);
+    for (size_t i = 1; i < count; ++i) {
+        uint64_t shared;
+        uint64_t rest_length;
+        if (!read_varint(data, offset, end, shared)
+            || !read_varint(data, offset, end, rest_length)
+            || shared > previous_length || rest_length > end - offset)
+            return false;
+        std::string_view rest(data + offset, rest_length);
+        offset += rest_length;
+        previous_length = shared + rest_length;
+
+        if (shared > matched)
+            continue;
+        if (shared < matched)
+            return false;
+        auto tail = value.substr(matched);
+        auto common = shared_prefix(rest, tail);
+        if (common == tail.size())
+            return common == rest.size();
+        if (common < rest.size()
+            && static_cast<unsigned char>(rest[common])
+                   > static_cast<unsigned char>(tail[common]))
+            return false;
+        matched += common;
+    }
+    return false;
+}
+
+Strset_table::const_iterator& Strset_table::const_iterator::operator++() {
+    if (remaining == 0) {
+        start_block(block + 1);
+        return *this;
+    }
+
+    auto end = table->block_end(block);
+    uint64_t shared;
+    uint64_t rest_length;
+    if (!read_varint(table->data, offset, end, shared)
+        || !read_varint(table->data, offset, end, rest_length)
+        || shared > key.size() || rest_length > end - offset) {
+        set_damaged();
+        return *this;
+    }
+    key.resize(shared);
+    key.append(table->data + offset, rest_length);
+    offset += rest_length;
+    --remaining;
+    return *this;
+}
+
+void Strset_table::const_iterator::start_block(size_t block_) {
+    block = block_;
+    offset = 0;
+    remaining = 0;
+    key.clear();
+    if (block == table->block_count)
+        return;
+
+    std::string_view first;
+    if (!table->first_string(block, first)) {
+        set_damaged();
+        return;
+    }
+    key.assign(first);
+    offset = first.data() + first.size() - table->data;
+    remaining = table->block_length(block) - 1;
+}
+
+void Strset_table::const_iterator::set_damaged() {
+    found_damage = true;
+    block = table->block_count;
+    offset = 0;
+    remaining = 0;
+    key.clear();
+}
+
+int jnp1::compare(const Strset_table& lhs, const Strset_table& rhs) {
+    return compare_elements(lhs, rhs);
+}
+
+int jnp1::compare(const Strset_table& lhs, const Strset_tree& rhs) {
+    return compare_elements(lhs, rhs);
+}
+
+int jnp1::compare(const Strset_tree& lhs, const Strset_table& rhs) {
+    return compare_elements(lhs, rhs);
+}
+
+bool jnp1::equal(const Strset_table& lhs, const Strset_table& rhs) {
+    return &lhs == &rhs || equal_elements(lhs, rhs);
+}
+
+bool jnp1::equal(const Strset_table& lhs, const Strset_tree& rhs) {
+    return equal_elements(lhs, rhs);
+}
+
+bool jnp1::equal(const Strset_tree& lhs, const Strset_table& rhs) {
+    return equal_elements(lhs, rhs);
+}
+
+bool jnp1::is_subset(const Strset_table& subset, const Strset_table& set) {
+    return &subset == &set || includes_elements(subset, set);
+}
+
+bool jnp1::is_subset(const Strset_table& subset, const Strset_tree& set) {
+    return includes_elements(subset, set);
+}
+
+bool jnp1::is_subset(const Strset_tree& subset, const Strset_table& set) {
+    return includes_elements(subset, set);
+}
@@ -0,0 +1,176 @@
+#ifndef STRSET_TABLE_H
+#define STRSET_TABLE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <memory>
+#include <string>
+#include <string_view>
+
+#include "strset_tree.h"
+
+namespace jnp1 {
+
+// Set of strings saved in a file, as a sorted string table, and read from
+// the file mapped into memory. The strings are front-coded: in blocks of
+// block_size strings, the first one is kept whole, and every next one as
+// the length of the prefix it shares with the previous one and the rest of
+// it. The sparse index has the offset of every block, so a string is found
+// by a binary search over the first strings of the blocks, and then a scan
+// of a single block, without copying any string.
+//
+// The file, with the numbers little-endian:
+//   header:  magic (8 bytes), number of the strings, number of the blocks,
+//            offset of the index (8 bytes each),
+//   blocks:  the first string as its length and characters, then the shared
+//            lengths, the lengths of the rests and the rests; the lengths
+//            are varints (7 bits per byte, the lowest first),
+//   index:   offsets of the blocks (8 bytes each).
+//
+// Opening a table checks its header and index only, so a damaged block is
+// found when it is read. Then the strings which follow the damage are not
+// seen, but nothing outside of the file is ever read.
+class Strset_table {
+public:
+    class const_iterator;
+
+    static constexpr size_t block_size{16};
+
+    // Maps the file. Returns nullptr if it cannot be mapped or is not a
+    // table.
+    static std::shared_ptr<const Strset_table> open(const char* path);
+
+    // Writes the set to the file. The file is replaced at once, after the
+    // whole table is written, so the tables already mapped from it do not
+    // change. Returns false if it could not be written.
+    static bool save(const Strset_tree& set, const char* path);
+
+    // Writes the table to the file, as save() does.
+    bool save(const char* path) const;
+
+    Strset_table(const Strset_table&) = delete;
+    Strset_table& operator=(const Strset_table&) = delete;
+    ~Strset_table();
+
+    size_t size() const {
+        return element_count;
+    }
+
+    bool contains(std::string_view value) const;
+
+    const_iterator begin() const;
+    const_iterator end() const;
+
+    // Returns the first string not less than the value.
+    const_iterator lower_bound(std::string_view value) const;
+
+    // Builds the tree of the strings. Returns false if the table is damaged,
+    // and then the tree has the strings before the damage.
+    bool to_tree(Strset_tree& tree) const;
+
+private:
+    Strset_table(const char* data_, size_t length_)
+        : data{data_}, length{length_} {}
+
+    // Reads the header and checks the index. Returns false if the table is
+    // not valid.
+    bool read_index();
+
+    // Offset of the block and the offset its last string ends at.
+    size_t block_begin(size_t block) const;
+    size_t block_end(size_t block) const;
+
+    // Number of the strings of the block.
+    size_t block_length(size_t block) const;
+
+    // Returns the last block whose first string is not greater than the
+    // value, or block_count if there is none or the table is damaged.
+    size_t find_block(std::string_view value) const;
+
+    // Finds the first string of the block. Returns false if it is damaged.
+    bool first_string(size_t block, std::string_view& first) const;
+
+    // Returns true if the value is in the block. Its first string must not
+    // be greater than the value.
+    bool block_contains(size_t block, std::string_view value) const;
+
+    const char* data;
+    size_t length;
+    size_t element_count{0};
+    size_t block_count{0};
+    size_t index_offset{0};
+};
+
+// Goes over the strings of the table in the increasing order. The string
+// is kept in the iterator, so it is valid until the iterator changes.
+class Strset_table::const_iterator {
+public:
+    using iterator_category = std::forward_iterator_tag;
+    using value_type = std::string_view;
+    using difference_type = std::ptrdiff_t;
+    using pointer = const std::string_view*;
+    using reference = std::string_view;
+
+    const_iterator() = default;
+
+    std::string_view operator*() const {
+        return key;
+    }
+
+    const_iterator& operator++();
+
+    const_iterator operator++(int) {
+        auto result = *this;
+        ++*this;
+        return result;
+    }
+
+    bool operator==(const const_iterator& other) const {
+        return block == other.block && offset == other.offset;
+    }
+
+    bool operator!=(const const_iterator& other) const {
+        return !(*this == other);
+    }
+
+    // Returns true if the iterator reached the end because the table is
+    // damaged.
+    bool damaged() const {
+        return found_damage;
+    }
+
+private:
+    friend class Strset_table;
+
+    // Reads the first string of the block, or goes to the end if there are
+    // no more blocks.
+    void start_block(size_t block_);
+    void set_damaged();
+
+    const Strset_table* table{nullptr};
+    size_t block{0};
+    // Where the next string of the block starts.
+    size_t offset{0};
+    // Number of the strings of the block not read yet.
+    size_t remaining{0};
+    std::string key;
+    bool found_damage{false};
+};
+
+// The functions of strset_tree.h for the tables, and for a table and a tree.
+int compare(const Strset_table& lhs, const Strset_table& rhs);
+int compare(const Strset_table& lhs, const Strset_tree& rhs);
+int compare(const Strset_tree& lhs, const Strset_table& rhs);
+
+bool equal(const Strset_table& lhs, const Strset_table& rhs);
+bool equal(const Strset_table& lhs, const Strset_tree& rhs);
+bool equal(const Strset_tree& lhs, const Strset_table& rhs);
+
+bool is_subset(const Strset_table& subset, const Strset_table& set);
+bool is_subset(const Strset_table& subset, const Strset_tree& set);
+bool is_subset(const Strset_tree& subset, const Strset_table& set);
+
+}  // namespace jnp1
+
+#endif
@@ -0,0 +1,474 @@
+#include "strset.h"
+#include "strsetconst.h"
+
+#include <algorithm>
+#include <cassert>
+#include <climits>
+#include <cstdio>
+#include <string>
+#include <thread>
+#include <vector>
+
+using jnp1::strset_clear;
+using jnp1::strset_clone;
+using jnp1::strset_comp;
+using jnp1::strset_delete;
+using jnp1::strset_difference;
+using jnp1::strset_equal;
+using jnp1::strset_insert;
+using jnp1::strset_insert_many;
+using jnp1::strset_intersection;
+using jnp1::strset_is_subset;
+using jnp1::strset_iter_begin;
+using jnp1::strset_iter_end;
+using jnp1::strset_iter_next;
+using jnp1::strset_load;
+using jnp1::strset_new;
+using jnp1::strset_new_interned;
+using jnp1::strset_open_mapped;
+using jnp1::strset_prefix_count;
+using jnp1::strset_range;
+using jnp1::strset_remove;
+using jnp1::strset_remove_many;
+using jnp1::strset_save;
+using jnp1::strset_size;
+using jnp1::strset_test;
+using jnp1::strset_test_many;
+using jnp1::strset_union;
+using jnp1::strset42;
+
+namespace {
+    constexpr int thread_count{8};
+    constexpr int rounds{200};
+
+    unsigned long shared_set;
+    std::vector<unsigned long> ids[thread_count];
+    unsigned long const_ids[thread_count];
+
+    // Every thread works on its own sets, and reads the shared one and the
+    // 42 Set at the same time.
+    void work(int thread) {
+        const_ids[thread] = strset42();
+        for (int round = 0; round < rounds; ++round) {
+            auto id = strset_new();
+            ids[thread].push_back(id);
+
+            auto value = std::to_string(thread) + "/" + std::to_string(round);
+            strset_insert(id, value.c_str());
+            strset_insert(id, "common");
+            strset_insert(id, "common");
+            assert(strset_size(id) == 2);
+            assert(strset_test(id, value.c_str()));
+            assert(strset_comp(id, shared_set) == -1);
+
+            assert(strset_test(shared_set, "common"));
+            assert(strset_size(shared_set) == 1);
+            assert(strset_size(strset42()) == 1);
+            strset_insert(strset42(), value.c_str());
+
+            strset_remove(id, value.c_str());
+            assert(strset_comp(id, shared_set) == 0);
+            strset_clear(id);
+            assert(strset_size(id) == 0);
+            if (round % 2 == 0) {
+                strset_delete(id);
+                assert(!strset_test(id, "common"));
+            }
+        }
+    }
+
+    // Slots of the deleted sets are reused, and their old ids stay invalid.
+    void check_reuse() {
+        std::vector<unsigned long> deleted;
+        for (int i = 0; i < 5000; ++i) {
+            auto id = strset_new();
+            strset_insert(id, "old");
+            strset_delete(id);
+            deleted.push_back(id);
+        }
+
+        std::vector<unsigned long> created;
+        for (int i = 0; i < 5000; ++i) {
+            created.push_back(strset_new());
+            strset_insert(created.back(), "new");
+        }
+        for (auto id : deleted) {
+            assert(strset_size(id) == 0);
+            assert(!strset_test(id, "new"));
+            strset_insert(id, "stale");
+            strset_delete(id);
+        }
+        for (auto id : created) {
+            assert(std::find(deleted.begin(), deleted.end(), id)
+                   == deleted.end());
+            assert(strset_size(id) == 1);
+            assert(!strset_test(id, "stale"));
+        }
+    }
+
+    // The batches work as the single calls one after another.
+    void check_batches() {
+        auto id = strset_new();
+        const char* values[]{"b", "a", nullptr, "b", "c"};
+        strset_insert_many(id, values, 5);
+        assert(strset_size(id) == 3);
+
+        const char* queries[]{"c", "x", nullptr, "a", "b"};
+        int results[5];
+        strset_test_many(id, queries, 5, results);
+        assert(results[0] == 1 && results[1] == 0 && results[2] == 0
+               && results[3] == 1 && results[4] == 1);
+
+        const char* removed[]{"a", "x", "a"};
+        strset_remove_many(id, removed, 3);
+        assert(strset_size(id) == 2);
+        assert(!strset_test(id, "a"));
+
+        strset_insert_many(strset42(), values, 5);
+        assert(strset_size(strset42()) == 1);
+        strset_test_many(strset42(), values, 5, results);
+        assert(results[0] == 0 && results[2] == 0);
+        strset_remove_many(strset42(), queries, 5);
+        assert(strset_size(strset42()) == 1);
+
+        strset_insert_many(id, nullptr, 5);
+        strset_test_many(id, nullptr, 5, results);
+        strset_test_many(id, values, 0, results);
+        strset_delete(id);
+        strset_insert_many(id, values, 5);
+        assert(strset_size(id) == 0);
+        results[0] = 1;
+        strset_test_many(id, values, 1, results);
+        assert(results[0] == 0);
+    }
+
+    // The set operations create new sets and leave the operands as they are.
+    void check_algebra() {
+        auto id1 = strset_new();
+        auto id2 = strset_new();
+        const char* values1[]{"a", "b", "c", "42"};
+        const char* values2[]{"b", "c", "d"};
+        strset_insert_many(id1, values1, 4);
+        strset_insert_many(id2, values2, 3);
+
+        auto sum = strset_union(id1, id2);
+        assert(strset_size(sum) == 5);
+        auto common = strset_intersection(id1, id2);
+        assert(strset_size(common) == 2);
+        assert(strset_test(common, "b") && strset_test(common, "c"));
+        auto only1 = strset_difference(id1, id2);
+        assert(strset_size(only1) == 2);
+        assert(strset_test(only1, "a") && strset_test(only1, "42"));
+        assert(strset_size(id1) == 4 && strset_size(id2) == 3);
+
+        assert(strset_is_subset(common, id1) && strset_is_subset(common, id2));
+        assert(strset_is_subset(id1, sum) && !strset_is_subset(sum, id1));
+        assert(strset_is_subset(strset42(), id1));
+        assert(!strset_is_subset(strset42(), id2));
+
+        // The 42 Set may be an operand, but it is never changed.
+        auto with42 = strset_union(strset42(), id2);
+        assert(strset_size(with42) == 4 && strset_size(strset42()) == 1);
+        assert(strset_comp(strset_intersection(strset42(), id1), strset42())
+               == 0);
+        assert(strset_size(strset_difference(strset42(), id1)) == 0);
+
+        // Non-existing sets are empty.
+        strset_delete(only1);
+        assert(strset_comp(strset_union(id1, only1), id1) == 0);
+        assert(strset_size(strset_intersection(only1, id1)) == 0);
+        assert(strset_is_subset(only1, id2) && !strset_is_subset(id2, only1));
+
+        // Big sets, merged in parallel if there are many cores.
+        auto big1 = strset_new();
+        auto big2 = strset_new();
+        for (int i = 0; i < 200000; ++i) {
+            auto value = std::to_string(i);
+            strset_insert(i % 2 == 0 ? big1 : big2, value.c_str());
+            if (i % 3 == 0)
+                strset_insert(big2, value.c_str());
+        }
+        assert(strset_size(strset_union(big1, big2)) == 200000);
+        assert(strset_size(strset_intersection(big1, big2)) == 33334);
+        assert(strset_size(strset_difference(big1, big2)) == 66666);
+    }
+
+    // strset_equal agrees with strset_comp, whatever order the elements
+    // were inserted in.
+    void check_equal() {
+        auto id1 = strset_new();
+        auto id2 = strset_new();
+        assert(strset_equal(id1, id2) && strset_equal(id1, id1 + 1000000));
+        for (int i = 0; i < 1000; ++i) {
+            auto value = std::to_string(i);
+            auto reversed = std::to_string(999 - i);
+            strset_insert(id1, value.c_str());
+            strset_insert(id2, reversed.c_str());
+        }
+        assert(strset_equal(id1, id2) && strset_comp(id1, id2) == 0);
+        assert(strset_equal(id1, id1));
+
+        strset_remove(id2, "500");
+        strset_insert(id2, "x");
+        assert(!strset_equal(id1, id2) && strset_comp(id1, id2) == -1);
+        strset_remove(id2, "x");
+        strset_insert(id2, "500");
+        assert(strset_equal(id1, id2));
+
+        auto copy = strset_union(id1, id1);
+        assert(strset_equal(copy, id1));
+        strset_clear(copy);
+        assert(!strset_equal(copy, id1));
+        assert(strset_equal(copy, strset_difference(id1, id2)));
+        assert(!strset_equal(strset42(), id1));
+    }
+
+    // Clones are frozen copies: changing the clone or the original does not
+    // change the other one.
+    void check_clone() {
+        auto original = strset_new();
+        for (int i = 0; i < 10000; ++i)
+            strset_insert(original, std::to_string(i).c_str());
+        auto snapshot = strset_clone(original);
+        assert(strset_comp(original, snapshot) == 0);
+
+        strset_remove(original, "5000");
+        strset_insert(original, "new");
+        assert(strset_size(snapshot) == 10000);
+        assert(strset_test(snapshot, "5000") && !strset_test(snapshot, "new"));
+        assert(strset_comp(original, snapshot) == 1);
+
+        auto second = strset_clone(snapshot);
+        strset_clear(snapshot);
+        assert(strset_size(second) == 10000);
+        strset_remove(original, "new");
+        strset_insert(original, "5000");
+        assert(strset_comp(original, second) == 0);
+
+        auto clone42 = strset_clone(strset42());
+        strset_insert(clone42, "43");
+        assert(strset_size(clone42) == 2 && strset_size(strset42()) == 1);
+
+        strset_delete(original);
+        assert(strset_size(second) == 10000);
+        assert(strset_size(strset_clone(original)) == 0);
+    }
+
+    // The interned sets work as the others, and compare with them by their
+    // elements.
+    void check_interned() {
+        auto plain = strset_new();
+        std::vector<unsigned long> interned;
+        for (int i = 0; i < 3; ++i)
+            interned.push_back(strset_new_interned());
+        const std::string prefix{"a string longer than 8 characters "};
+        for (int i = 0; i < 1000; ++i) {
+            auto value = prefix + std::to_string(i);
+            strset_insert(plain, value.c_str());
+            for (auto id : interned)
+                strset_insert(id, value.c_str());
+        }
+        strset_insert(interned[0], "short");
+        strset_insert(plain, "short");
+        assert(strset_comp(plain, interned[0]) == 0);
+        assert(strset_comp(interned[1], interned[2]) == 0);
+        assert(strset_comp(interned[1], interned[0]) == -1);
+        assert(strset_equal(interned[0], plain));
+
+        auto removed = prefix + "500";
+        strset_remove(interned[0], removed.c_str());
+        assert(!strset_test(interned[0], removed.c_str()));
+        assert(strset_test(interned[1], removed.c_str()));
+        assert(strset_comp(interned[0], plain) == 1);
+
+        auto clone = strset_clone(interned[1]);
+        strset_delete(interned[1]);
+        strset_delete(interned[2]);
+        assert(strset_size(clone) == 1000);
+        assert(strset_size(strset_difference(plain, clone)) == 1);
+        assert(strset_size(strset_intersection(clone, interned[0])) == 999);
+        assert(strset_is_subset(strset_intersection(clone, plain), plain));
+    }
+
+    // The saved sets are loaded and mapped with the same elements, and the
+    // mapped ones do not change.
+    void check_snapshots() {
+        const char* path = "strset_test3.snapshot";
+        auto original = strset_new();
+        for (int i = 0; i < 5000; ++i) {
+            auto value = "prefix/" + std::to_string(i * 7919 % 5000);
+            strset_insert(original, value.c_str());
+        }
+        strset_insert(original, "");
+        strset_insert(original, "prefix");
+        assert(strset_save(original, path));
+
+        auto loaded = strset_load(path);
+        auto mapped = strset_open_mapped(path);
+        assert(strset_equal(loaded, original) && strset_equal(mapped, loaded));
+        assert(strset_comp(mapped, original) == 0);
+        assert(strset_size(mapped) == 5002);
+        assert(strset_test(mapped, "") && strset_test(mapped, "prefix"));
+        assert(strset_test(mapped, "prefix/4999"));
+        assert(!strset_test(mapped, "prefix/5000"));
+        assert(!strset_test(mapped, "prefix/"));
+
+        strset_insert(mapped, "new");
+        strset_remove(mapped, "prefix");
+        strset_clear(mapped);
+        assert(strset_size(mapped) == 5002);
+
+        // The loaded set is an ordinary one.
+        strset_insert(loaded, "zzz");
+        assert(strset_comp(mapped, loaded) == -1);
+        assert(strset_is_subset(mapped, loaded));
+        assert(!strset_is_subset(loaded, mapped));
+        assert(strset_size(strset_difference(loaded, mapped)) == 1);
+        assert(strset_size(strset_union(mapped, strset42())) == 5003);
+
+        // Replacing the file does not change the mapped set, and its clone
+        // is mapped from the same file.
+        assert(strset_save(loaded, path));
+        assert(strset_size(mapped) == 5002 && strset_size(strset_load(path))
+                                                  == 5003);
+        auto clone = strset_clone(mapped);
+        strset_delete(mapped);
+        assert(strset_equal(clone, original));
+        assert(strset_save(clone, path));
+        assert(strset_equal(strset_open_mapped(path), original));
+
+        std::remove(path);
+        assert(strset_load(path) == ULONG_MAX);
+        assert(strset_open_mapped(path) == ULONG_MAX);
+        assert(!strset_save(original, nullptr));
+        assert(!strset_save(mapped, path));
+    }
+
+    // Collects the elements passed to the callback of strset_range, up to
+    // the limit.
+    struct Collected {
+        std::vector<std::string> values;
+        size_t limit;
+    };
+
+    int collect(const char* value, void* context) {
+        auto& collected = *static_cast<Collected*>(context);
+        collected.values.push_back(value);
+        return collected.values.size() == collected.limit;
+    }
+
+    // The cursors and the ranges go over the elements in order, and the
+    // cursors stay valid when the set changes.
+    void check_cursors() {
+        auto id = strset_new();
+        for (int i = 0; i < 1000; ++i) {
+            auto value = "key" + std::to_string(i);
+            strset_insert(id, value.c_str());
+        }
+
+        auto iter = strset_iter_begin(id);
+        const char* value;
+        std::vector<std::string> seen;
+        while (strset_iter_next(iter, &value) == 1) {
+            seen.push_back(value);
+            // Removes the next element and inserts one further on.
+            if (seen.size() == 10) {
+                strset_remove(id, "key108");
+                strset_insert(id, "key9999");
+                strset_insert(id, "a");
+            }
+        }
+        assert(value == nullptr);
+        assert(seen.size() == 1000);
+        assert(std::is_sorted(seen.begin(), seen.end()));
+        assert(std::count(seen.begin(), seen.end(), "key108") == 0);
+        assert(std::count(seen.begin(), seen.end(), "key9999") == 1);
+        assert(std::count(seen.begin(), seen.end(), "a") == 0);
+
+        // A cursor at the end sees the elements inserted later.
+        strset_insert(id, "zzz");
+        assert(strset_iter_next(iter, &value) == 1);
+        assert(std::string(value) == "zzz");
+        assert(strset_iter_next(iter, &value) == 0);
+        strset_iter_end(iter);
+        assert(strset_iter_next(iter, &value) == -1);
+
+        assert(strset_prefix_count(id, "key1") == 110);
+        assert(strset_prefix_count(id, "key") == 1000);
+        assert(strset_prefix_count(id, "") == 1002);
+        assert(strset_prefix_count(id, "kez") == 0);
+        assert(strset_prefix_count(strset42(), "4") == 1);
+
+        Collected collected{{}, 0};
+        assert(strset_range(id, "key10", "key11", collect, &collected) == 10);
+        assert(collected.values.front() == "key10"
+               && collected.values.back() == "key109");
+        collected = {{}, 3};
+        assert(strset_range(id, nullptr, nullptr, collect, &collected) == 3);
+        assert(collected.values[0] == "a" && collected.values[2] == "key1");
+        collected = {{}, 0};
+        assert(strset_range(id, "zz", nullptr, collect, &collected) == 1);
+        assert(strset_range(id, "b", "a", collect, &collected) == 0);
+
+        // The cursors of the mapped sets, and of the deleted ones.
+        const char* path = "strset_test3.snapshot";
+        assert(strset_save(id, path));
+        auto mapped = strset_open_mapped(path);
+        std::remove(path);
+        assert(strset_prefix_count(mapped, "key1") == 110);
+        collected = {{}, 0};
+        assert(strset_range(mapped, "key10", "key11", collect, &collected)
+               == 10);
+        auto mapped_iter = strset_iter_begin(mapped);
+        size_t count = 0;
+        while (strset_iter_next(mapped_iter, &value) == 1)
+            ++count;
+        assert(count == 1002);
+
+        iter = strset_iter_begin(id);
+        assert(strset_iter_next(iter, &value) == 1);
+        strset_delete(id);
+        assert(strset_iter_next(iter, &value) == -1 && value == nullptr);
+        assert(strset_iter_begin(id) == ULONG_MAX);
+        assert(strset_range(id, nullptr, nullptr, collect, &collected) == 0);
+    }
+}
+
+int main() {
+    shared_set = strset_new();
+    strset_insert(shared_set, "common");
+
+    std::vector<std::thread> threads;
+    for (int thread = 0; thread < thread_count; ++thread)
+        threads.emplace_back(work, thread);
+    for (auto& thread : threads)
+        thread.join();
+
+    // Every thread got the same 42 Set and different ids of its own sets.
+    std::vector<unsigned long> all_ids{shared_set};
+    for (int thread = 0; thread < thread_count; ++thread) {
+        assert(const_ids[thread] == strset42());
+        all_ids.insert(all_ids.end(), ids[thread].begin(), ids[thread].end());
+    }
+    std::sort(all_ids.begin(), all_ids.end());
+    assert(std::adjacent_find(all_ids.begin(), all_ids.end())
+           == all_ids.end());
+    assert(strset_size(strset42()) == 1);
+
+    // The deleted sets are gone, the others are empty.
+    for (int thread = 0; thread < thread_count; ++thread) {
+        for (int round = 0; round < rounds; ++round) {
+            strset_insert(ids[thread][round], "last");
+            assert(strset_size(ids[thread][round]) == (round % 2 == 0 ? 0 : 1));
+        }
+    }
+
+    check_reuse();
+    check_batches();
+    check_algebra();
+    check_equal();
+    check_clone();
+    check_interned();
+    check_snapshots();
+    check_cursors();
+}
@@ -0,0 +1,850 @@
+#include <algorithm>
+#include <cstring>
+#include <functional>
+#include <limits>
+#include <stdexcept>
+#include <system_error>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "strset_tree.h"
+
+using jnp1::Strset_tree;
+
+namespace {
+
+// The first 8 characters of the key, as a big-endian number, so that the
+// numbers compare the same as the characters do.
+uint64_t head_value(const char* head) {
+    uint64_t value;
+    std::memcpy(&value, head, sizeof(value));
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    value = __builtin_bswap64(value);
+#endif
+    return value;
+}
+
+// Hash of the element, mixed well enough for the sums of the hashes to
+// differ for different sets (the finalizer of splitmix64).
+uint64_t element_hash(std::string_view value) {
+    uint64_t hash = std::hash<std::string_view>{}(value);
+    hash = (hash ^ (hash >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    hash = (hash ^ (hash >> 27)) * 0x94d049bb133111ebULL;
+    return hash ^ (hash >> 31);
+}
+
+int sign(int value) {
+    return (value > 0) - (value < 0);
+}
+
+// Compares the strings, at once if they are the same string of the pool.
+int compare_texts(std::string_view lhs, std::string_view rhs) {
+    if (lhs.data() == rhs.data() && lhs.size() == rhs.size())
+        return 0;
+    return lhs.compare(rhs);
+}
+
+// Splits [count] items into the least number of parts of at most [capacity]
+// items whose sizes differ by at most one, and calls visit(begin, end) for
+// every part. So no part but the only one is less than a half full.
+template <typename Visit>
+void split_evenly(size_t count, size_t capacity, Visit visit) {
+    size_t parts = (count + capacity - 1) / capacity;
+    size_t begin = 0;
+    for (size_t part = 0; part < parts; ++part) {
+        size_t size = count / parts + (part < count % parts ? 1 : 0);
+        visit(begin, begin + size);
+        begin += size;
+    }
+}
+
+enum class Set_operation { set_union, set_intersection, set_difference };
+
+// Appends the result of the operation on the ranges of two sets to [result].
+void merge(Strset_tree::const_iterator left,
+           Strset_tree::const_iterator left_end,
+           Strset_tree::const_iterator right,
+           Strset_tree::const_iterator right_end, Set_operation operation,
+           std::vector<std::string_view>& result) {
+    while (left != left_end && right != right_end) {
+        int order = compare_texts(*left, *right);
+        if (order < 0) {
+            if (operation != Set_operation::set_intersection)
+                result.push_back(*left);
+            ++left;
+        }
+        else if (order > 0) {
+            if (operation == Set_operation::set_union)
+                result.push_back(*right);
+            ++right;
+        }
+        else {
+            if (operation != Set_operation::set_difference)
+                result.push_back(*left);
+            ++left;
+            ++right;
+        }
+    }
+    if (operation != Set_operation::set_intersection) {
+        for (; left != left_end; ++left)
+            result.push_back(*left);
+    }
+    if (operation == Set_operation::set_union) {
+        for (; right != right_end; ++right)
+            result.push_back(*right);
+    }
+}
+
+// Merges the sets, in parallel if thread_count > 1: the key space is split at
+// the split points of the bigger set, and every range is merged by its own
+// thread. If a thread cannot be started, its range is merged by this one.
+Strset_tree combine(const Strset_tree& lhs, const Strset_tree& rhs,
+                    Set_operation operation, unsigned thread_count) {
+    const auto& bigger = lhs.size() >= rhs.size() ? lhs : rhs;
+    auto points = bigger.split_points(std::max(thread_count, 1U));
+    std::vector<std::vector<std::string_view>> parts(points.size());
+
+    auto merge_part = [&](size_t part) {
+        bool last = part + 1 == points.size();
+        merge(lhs.lower_bound(points[part]),
+              last ? lhs.end() : lhs.lower_bound(points[part + 1]),
+              rhs.lower_bound(points[part]),
+              last ? rhs.end() : rhs.lower_bound(points[part + 1]),
+              operation, parts[part]);
+    };
+
+    std::vector<std::thread> threads;
+    for (size_t part = 1; part < points.size(); ++part) {
+        try {
+            threads.emplace_back(merge_part, part);
+        }
+        catch (const std::system_error&) {
+            merge_part(part);
+        }
+    }
+    merge_part(0);
+    for (auto& thread : threads)
+        thread.join();
+
+    if (parts.size() == 1)
+        return Strset_tree::from_sorted(parts[0], lhs.storage());
+
+    size_t total = 0;
+    for (const auto& part : parts)
+        total += part.size();
+    std::vector<std::string_view> values;
+    values.reserve(total);
+    for (const auto& part : parts)
+        values.insert(values.end(), part.begin(), part.end());
+    return Strset_tree::from_sorted(values, lhs.storage());
+}
+
+}  // namespace
+
+// The value looked for, with its head computed once.
+struct Strset_tree::Probe {
+    explicit Probe(std::string_view text_) : text{text_} {
+        char head[inline_length]{};
+        if (!text.empty())
+            std::memcpy(head, text.data(),
+                        std::min<size_t>(text.size(), inline_length));
+        head_number = head_value(head);
+    }
+
+    std::string_view text;
+    uint64_t head_number;
+};
+
+// Result of the insertion into a subtree: whether the value was inserted, and
+// the new right sibling of the subtree's root with its smallest key, if the
+// root was split.
+struct Strset_tree::Split {
+    bool inserted;
+    Node_ptr right;
+    std::string separator;
+};
+
+void Strset_tree::Node_deleter::operator()(Node* node) const {
+    if (node->interned) {
+        for (int i = 0; i < node->count; ++i) {
+            if (node->lengths[i] > inline_length)
+                String_pool::release(node->offsets[i]);
+        }
+    }
+    if (node->leaf)
+        delete node;
+    else
+        delete static_cast<Inner*>(node);
+}
+
+namespace jnp1 {
+
+// Helpers working on the nodes, in a friend struct, so that they can use the
+// private types of the tree.
+struct Strset_tree_nodes {
+    using Node = Strset_tree::Node;
+    using Inner = Strset_tree::Inner;
+    using Node_ptr = Strset_tree::Node_ptr;
+    using Probe = Strset_tree::Probe;
+    static constexpr auto inline_length = Strset_tree::inline_length;
+
+    // Compares the key i of the node with the probe, returns -1, 0 or 1.
+    static int compare(const Node& node, int i, const Probe& probe) {
+        auto head = head_value(node.heads[i]);
+        if (head != probe.head_number)
+            return head < probe.head_number ? -1 : 1;
+        auto length = node.lengths[i];
+        if (length <= inline_length && probe.text.size() <= inline_length)
+            return sign(static_cast<int>(length)
+                        - static_cast<int>(probe.text.size()));
+        return sign(node.text(i).compare(probe.text));
+    }
+
+    // Returns the first of the keys [from, count) of the node which is not
+    // less than the probe.
+    static int lower_bound(const Node& node, int from, const Probe& probe) {
+        int begin = from;
+        int end = node.count;
+        while (begin < end) {
+            int middle = begin + (end - begin) / 2;
+            if (compare(node, middle, probe) < 0)
+                begin = middle + 1;
+            else
+                end = middle;
+        }
+        return begin;
+    }
+
+    // Returns the position of the child of the inner node whose subtree may
+    // contain the probe.
+    static int child_position(const Node& node, const Probe& probe) {
+        int begin = 1;
+        int end = node.count;
+        while (begin < end) {
+            int middle = begin + (end - begin) / 2;
+            if (compare(node, middle, probe) <= 0)
+                begin = middle + 1;
+            else
+                end = middle;
+        }
+        return begin - 1;
+    }
+
+    static Node* child(Node& node, int i) {
+        return static_cast<Inner&>(node).children[i].get();
+    }
+
+    // Returns the node, copied first if it is shared, so that it can be
+    // changed.
+    static Node& own(Node_ptr& node) {
+        if (node.shared())
+            node = Strset_tree::copy(*node);
+        return *node;
+    }
+
+    static Node& own_child(Node& node, int i) {
+        return own(static_cast<Inner&>(node).children[i]);
+    }
+
+    // Throws std::length_error if the lengths or offsets do not fit in 32
+    // bits, or the pool is full, and then the key is left as it was.
+    static void set_key(Node& node, int i, std::string_view text) {
+        constexpr size_t max_length{std::numeric_limits<uint32_t>::max()};
+        uint32_t offset = 0;
+        if (text.size() > inline_length) {
+            if (node.interned) {
+                offset = String_pool::intern(text);
+            }
+            else {
+                if (text.size() > max_length
+                    || node.arena.size() > max_length)
+                    throw std::length_error{"Strset_tree: node too long"};
+                offset = static_cast<uint32_t>(node.arena.size());
+                node.arena.append(text);
+            }
+        }
+
+        std::memset(node.heads[i], 0, inline_length);
+        if (!text.empty())
+            std::memcpy(node.heads[i], text.data(),
+                        std::min<size_t>(text.size(), inline_length));
+        node.lengths[i] = static_cast<uint32_t>(text.size());
+        node.offsets[i] = offset;
+    }
+
+    // Frees the characters of the key i, if it has any in the arena or in
+    // the pool.
+    static void release_key(Node& node, int i) {
+        if (node.lengths[i] <= inline_length)
+            return;
+        if (node.interned)
+            String_pool::release(node.offsets[i]);
+        else
+            node.dead_bytes += node.lengths[i];
+    }
+
+    // Moves the key i of the node [from] to the place j of the node [to].
+    // The interned strings keep their references.
+    static void move_key(Node& from, int i, Node& to, int j) {
+        if (from.interned && to.interned) {
+            std::memcpy(to.heads[j], from.heads[i], inline_length);
+            to.lengths[j] = from.lengths[i];
+            to.offsets[j] = from.offsets[i];
+            return;
+        }
+        set_key(to, j, from.text(i));
+        release_key(from, i);
+    }
+
+    // Moves [count] keys from the position [from] to [to], which may
+    // overlap.
+    static void move_keys(Node& node, int from, int to, int count) {
+        std::memmove(node.heads + to, node.heads + from,
+                     count * sizeof(node.heads[0]));
+        std::memmove(node.lengths + to, node.lengths + from,
+                     count * sizeof(node.lengths[0]));
+        std::memmove(node.offsets + to, node.offsets + from,
+                     count * sizeof(node.offsets[0]));
+    }
+
+    // Makes place for the key (and the child, in an inner node) at i.
+    static void open_gap(Node& node, int i) {
+        move_keys(node, i, i + 1, node.count - i);
+        if (!node.leaf) {
+            auto& children = static_cast<Inner&>(node).children;
+            std::move_backward(children + i, children + node.count,
+                               children + node.count + 1);
+        }
+        ++node.count;
+    }
+
+    // Removes the key (and the child, in an inner node) at i.
+    static void close_gap(Node& node, int i) {
+        release_key(node, i);
+        move_keys(node, i + 1, i, node.count - i - 1);
+        if (!node.leaf) {
+            auto& children = static_cast<Inner&>(node).children;
+            std::move(children + i + 1, children + node.count,
+                      children + i);
+            children[node.count - 1].reset();
+        }
+        --node.count;
+        compact_if_sparse(node);
+    }
+
+    // Rewrites the arena without the unused characters, if they take more
+    // than a half of it.
+    static void compact_if_sparse(Node& node) {
+        if (node.dead_bytes * 2 <= node.arena.size())
+            return;
+
+        std::string arena;
+        arena.reserve(node.arena.size() - node.dead_bytes);
+        for (int i = 0; i < node.count; ++i) {
+            if (node.lengths[i] > inline_length) {
+                auto offset = static_cast<uint32_t>(arena.size());
+                arena.append(node.arena, node.offsets[i], node.lengths[i]);
+                node.offsets[i] = offset;
+            }
+        }
+        node.arena = std::move(arena);
+        node.dead_bytes = 0;
+    }
+
+    // Moves the keys [from, count) of the node (and their children) to the
+    // empty node [right].
+    static void move_tail(Node& node, int from, Node& right) {
+        for (int i = from; i < node.count; ++i)
+            move_key(node, i, right, i - from);
+        if (!node.leaf) {
+            auto& children = static_cast<Inner&>(node).children;
+            std::move(children + from, children + node.count,
+                      static_cast<Inner&>(right).children);
+        }
+        right.count = node.count - from;
+        node.count = from;
+        compact_if_sparse(node);
+    }
+
+    // Creates an empty leaf or inner node.
+    static Node_ptr make_node(bool leaf, bool interned) {
+        if (leaf)
+            return Node_ptr{new Node{true, interned}};
+        return Node_ptr{new Inner{interned}};
+    }
+};
+
+}  // namespace jnp1
+
+using Nodes = jnp1::Strset_tree_nodes;
+
+Strset_tree::Strset_tree(const Strset_tree& other)
+    : root{other.root},
+      element_count{other.element_count},
+      element_hash_sum{other.element_hash_sum},
+      key_storage{other.key_storage} {}
+
+Strset_tree::Strset_tree(Strset_tree&& other) noexcept
+    : root{std::move(other.root)},
+      element_count{other.element_count},
+      element_hash_sum{other.element_hash_sum},
+      key_storage{other.key_storage},
+      change_count{other.change_count} {
+    other.element_count = 0;
+    other.element_hash_sum = 0;
+}
+
+Strset_tree& Strset_tree::operator=(Strset_tree other) noexcept {
+    std::swap(root, other.root);
+    std::swap(element_count, other.element_count);
+    std::swap(element_hash_sum, other.element_hash_sum);
+    std::swap(key_storage, other.key_storage);
+    ++change_count;
+    return *this;
+}
+
+Strset_tree::Node_ptr Strset_tree::copy(const Node& node) {
+    auto result = Nodes::make_node(node.leaf, node.interned);
+    result->count = node.count;
+    result->arena = node.arena;
+    result->dead_bytes = node.dead_bytes;
+    std::memcpy(result->heads, node.heads,
+                node.count * sizeof(node.heads[0]));
+    std::memcpy(result->lengths, node.lengths,
+                node.count * sizeof(node.lengths[0]));
+    std::memcpy(result->offsets, node.offsets,
+                node.count * sizeof(node.offsets[0]));
+    if (node.interned) {
+        for (int i = 0; i < node.count; ++i) {
+            if (node.lengths[i] > inline_length)
+                String_pool::add_reference(node.offsets[i]);
+        }
+    }
+    if (!node.leaf) {
+        const auto& children = static_cast<const Inner&>(node).children;
+        std::copy(children, children + node.count,
+                  static_cast<Inner&>(*result).children);
+    }
+    return result;
+}
+
+Strset_tree Strset_tree::from_sorted(
+    const std::vector<std::string_view>& values, Storage storage) {
+    Strset_tree tree{storage};
+    if (values.empty())
+        return tree;
+
+    bool interned = storage == Storage::interned;
+    // Nodes of the level being built, and the smallest keys of their
+    // subtrees.
+    std::vector<Node_ptr> level;
+    std::vector<std::string_view> smallest;
+    split_evenly(values.size(), capacity, [&](size_t begin, size_t end) {
+        auto leaf = Nodes::make_node(true, interned);
+        if (!interned) {
+            size_t arena_size = 0;
+            for (size_t i = begin; i < end; ++i) {
+                if (values[i].size() > inline_length)
+                    arena_size += values[i].size();
+            }
+            leaf->arena.reserve(arena_size);
+        }
+        for (size_t i = begin; i < end; ++i)
+            Nodes::set_key(*leaf, static_cast<int>(i - begin), values[i]);
+        leaf->count = static_cast<int>(end - begin);
+        level.push_back(std::move(leaf));
+        smallest.push_back(values[begin]);
+    });
+
+    while (level.size() > 1) {
+        std::vector<Node_ptr> parents;
+        std::vector<std::string_view> parents_smallest;
+        split_evenly(level.size(), capacity, [&](size_t begin, size_t end) {
+            auto parent = Nodes::make_node(false, interned);
+            auto& children = static_cast<Inner&>(*parent).children;
+            for (size_t i = begin; i < end; ++i) {
+                auto position = static_cast<int>(i - begin);
+                Nodes::set_key(*parent, position,
+                               i == begin ? std::string_view{} : smallest[i]);
+                children[position] = std::move(level[i]);
+            }
+            parent->count = static_cast<int>(end - begin);
+            parents.push_back(std::move(parent));
+            parents_smallest.push_back(smallest[begin]);
+        });
+        level = std::move(parents);
+        smallest = std::move(parents_smallest);
+    }
+
+    tree.root = std::move(level[0]);
+    tree.element_count = values.size();
+    for (auto value : values)
+        tree.element_hash_sum += element_hash(value);
+    return tree;
+}
+
+bool Strset_tree::insert(std::string_view value) {
+    Probe probe{value};
+    if (!root) {
+        ++change_count;
+        auto leaf = Nodes::make_node(true, key_storage == Storage::interned);
+        Nodes::set_key(*leaf, 0, value);
+        leaf->count = 1;
+        root = std::move(leaf);
+        element_count = 1;
+        element_hash_sum = element_hash(value);
+        return true;
+    }
+
+    // A tree sharing its root with a copy does not copy the path for
+    // nothing.
+    if (root.shared() && contains(value))
+        return false;
+
+    // The nodes on the path may be copied even if the value is there.
+    ++change_count;
+    auto split = insert(Nodes::own(root), probe);
+    if (split.right) {
+        auto new_root = Nodes::make_node(false, root->interned);
+        auto& children = static_cast<Inner&>(*new_root).children;
+        children[0] = std::move(root);
+        children[1] = std::move(split.right);
+        Nodes::set_key(*new_root, 0, {});
+        Nodes::set_key(*new_root, 1, split.separator);
+        new_root->count = 2;
+        root = std::move(new_root);
+    }
+    if (split.inserted) {
+        ++element_count;
+        element_hash_sum += element_hash(value);
+    }
+    return split.inserted;
+}
+
+// Inserts into the subtree, and splits its root if it gets overfull.
+Strset_tree::Split Strset_tree::insert(Node& node, const Probe& probe) {
+    Split result{false, Node_ptr{}, {}};
+    if (node.leaf) {
+        int i = Nodes::lower_bound(node, 0, probe);
+        if (i < node.count && Nodes::compare(node, i, probe) == 0)
+            return result;
+        Nodes::open_gap(node, i);
+        try {
+            Nodes::set_key(node, i, probe.text);
+        }
+        catch (...) {
+            // The gap has a copy of the next key, which is not released.
+            node.lengths[i] = 0;
+            Nodes::close_gap(node, i);
+            throw;
+        }
+        result.inserted = true;
+    }
+    else {
+        int i = Nodes::child_position(node, probe);
+        auto child_split = insert(Nodes::own_child(node, i), probe);
+        result.inserted = child_split.inserted;
+        if (!child_split.right)
+            return result;
+        Nodes::open_gap(node, i + 1);
+        Nodes::set_key(node, i + 1, child_split.separator);
+        static_cast<Inner&>(node).children[i + 1] =
+            std::move(child_split.right);
+    }
+
+    if (node.count <= capacity)
+        return result;
+
+    // The smallest key of the right half goes up. In an inner node it stays
+    // as the unused key 0 of the right half.
+    result.right = Nodes::make_node(node.leaf, node.interned);
+    Nodes::move_tail(node, node.count / 2, *result.right);
+    result.separator = std::string(result.right->text(0));
+    return result;
+}
+
+bool Strset_tree::erase(std::string_view value) {
+    if (!root)
+        return false;
+
+    Probe probe{value};
+    if (root.shared() && !contains(value))
+        return false;
+    ++change_count;
+    if (!erase(Nodes::own(root), probe))
+        return false;
+
+    --element_count;
+    element_hash_sum -= element_hash(value);
+    if (root->count == 0) {
+        root.reset();
+    }
+    else if (!root->leaf && root->count == 1) {
+        auto child = std::move(static_cast<Inner&>(*root).children[0]);
+        root = std::move(child);
+    }
+    return true;
+}
+
+bool Strset_tree::erase(Node& node, const Probe& probe) {
+    if (node.leaf) {
+        int i = Nodes::lower_bound(node, 0, probe);
+        if (i == node.count || Nodes::compare(node, i, probe) != 0)
+            return false;
+        Nodes::close_gap(node, i);
+        return true;
+    }
+
+    int i = Nodes::child_position(node, probe);
+    if (!erase(Nodes::own_child(node, i), probe))
+        return false;
+
+    if (Nodes::child(node, i)->count < min_count && node.count > 1)
+        rebalance(static_cast<Inner&>(node), i + 1 < node.count ? i : i - 1);
+    return true;
+}
+
+// Moves the keys between the children i and i + 1 of the parent, so that
+// both have enough of them, or merges them if they fit in one node.
+void Strset_tree::rebalance(Inner& parent, int i) {
+    auto& left = *parent.children[i];
+    auto& right = *parent.children[i + 1];
+
+    // All keys of both nodes in order. Key 0 of the right inner node is the
+    // separator from the parent, as it is the smallest key of its subtree.
+    std::vector<std::string> texts;
+    texts.reserve(left.count + right.count);
+    for (int j = 0; j < left.count; ++j)
+        texts.emplace_back(left.text(j));
+    if (!left.leaf)
+        texts[0].clear();
+    texts.emplace_back(right.leaf ? right.text(0) : parent.text(i + 1));
+    for (int j = 1; j < right.count; ++j)
+        texts.emplace_back(right.text(j));
+
+    // The children are copied, not moved, as the sibling may be shared.
+    std::vector<Node_ptr> children;
+    if (!left.leaf) {
+        auto& left_children = static_cast<Inner&>(left).children;
+        auto& right_children = static_cast<Inner&>(right).children;
+        for (int j = 0; j < left.count; ++j)
+            children.push_back(left_children[j]);
+        for (int j = 0; j < right.count; ++j)
+            children.push_back(right_children[j]);
+    }
+
+    // The old nodes are freed when they are replaced.
+    bool leaf = left.leaf;
+    bool interned = left.interned;
+    int total = static_cast<int>(texts.size());
+    int left_count = total <= capacity ? total : total / 2;
+    auto fill = [&](int from, int to) {
+        auto node = Nodes::make_node(leaf, interned);
+        for (int j = from; j < to; ++j) {
+            Nodes::set_key(*node, j - from, texts[j]);
+            if (!node->leaf)
+                static_cast<Inner&>(*node).children[j - from] =
+                    std::move(children[j]);
+        }
+        node->count = to - from;
+        return node;
+    };
+
+    parent.children[i] = fill(0, left_count);
+    if (left_count == total) {
+        Nodes::close_gap(parent, i + 1);
+        return;
+    }
+    parent.children[i + 1] = fill(left_count, total);
+    Nodes::release_key(parent, i + 1);
+    Nodes::set_key(parent, i + 1, texts[left_count]);
+    Nodes::compact_if_sparse(parent);
+}
+
+bool Strset_tree::contains(std::string_view value) const {
+    if (!root)
+        return false;
+
+    Probe probe{value};
+    const Node* node = root.get();
+    while (!node->leaf)
+        node = static_cast<const Inner*>(node)
+                   ->children[Nodes::child_position(*node, probe)].get();
+    int i = Nodes::lower_bound(*node, 0, probe);
+    return i < node->count && Nodes::compare(*node, i, probe) == 0;
+}
+
+void Strset_tree::clear() {
+    ++change_count;
+    root.reset();
+    element_count = 0;
+    element_hash_sum = 0;
+}
+
+Strset_tree::const_iterator Strset_tree::begin() const {
+    const_iterator result;
+    if (root)
+        result.descend(root.get());
+    return result;
+}
+
+Strset_tree::const_iterator Strset_tree::end() const {
+    return const_iterator{};
+}
+
+Strset_tree::const_iterator Strset_tree::lower_bound(
+    std::string_view value) const {
+    const_iterator result;
+    if (!root)
+        return result;
+
+    Probe probe{value};
+    const Node* node = root.get();
+    while (!node->leaf) {
+        auto* inner = static_cast<const Inner*>(node);
+        int position = Nodes::child_position(*node, probe);
+        result.path[result.depth] = inner;
+        result.positions[result.depth] = position;
+        ++result.depth;
+        node = inner->children[position].get();
+    }
+    result.leaf = node;
+    result.index = Nodes::lower_bound(*node, 0, probe);
+    if (result.index == node->count)
+        result.next_leaf();
+    return result;
+}
+
+std::vector<std::string_view> Strset_tree::split_points(size_t count) const {
+    // The nodes of one level and the smallest keys of their subtrees, going
+    // down until there are enough of them.
+    std::vector<const Node*> nodes;
+    std::vector<std::string_view> smallest{std::string_view{}};
+    if (root)
+        nodes.push_back(root.get());
+    while (smallest.size() < count && !nodes.empty() && !nodes[0]->leaf) {
+        std::vector<const Node*> children;
+        std::vector<std::string_view> children_smallest;
+        for (size_t i = 0; i < nodes.size(); ++i) {
+            auto* inner = static_cast<const Inner*>(nodes[i]);
+            for (int j = 0; j < inner->count; ++j) {
+                children.push_back(inner->children[j].get());
+                children_smallest.push_back(j == 0 ? smallest[i]
+                                                   : inner->text(j));
+            }
+        }
+        nodes = std::move(children);
+        smallest = std::move(children_smallest);
+    }
+
+    if (smallest.size() <= count)
+        return smallest;
+    std::vector<std::string_view> result;
+    for (size_t i = 0; i < count; ++i)
+        result.push_back(smallest[i * smallest.size() / count]);
+    return result;
+}
+
+void Strset_tree::const_iterator::descend(const Node* node) {
+    while (!node->leaf) {
+        path[depth] = static_cast<const Inner*>(node);
+        positions[depth] = 0;
+        ++depth;
+        node = path[depth - 1]->children[0].get();
+    }
+    leaf = node;
+    index = 0;
+}
+
+void Strset_tree::const_iterator::next_leaf() {
+    while (depth > 0) {
+        auto& position = positions[depth - 1];
+        const auto* inner = path[depth - 1];
+        if (++position < inner->count) {
+            descend(inner->children[position].get());
+            return;
+        }
+        --depth;
+    }
+    leaf = nullptr;
+    index = 0;
+}
+
+int jnp1::compare(const Strset_tree& lhs, const Strset_tree& rhs) {
+    if (lhs.root.get() == rhs.root.get())
+        return 0;
+
+    auto left = lhs.begin();
+    auto right = rhs.begin();
+    while (left != lhs.end() && right != rhs.end()) {
+        // At the same place of a shared leaf, the rest of it is the same in
+        // both sets, and so are the rest of its ancestors which are shared
+        // too. They are skipped at once.
+        if (left.leaf == right.leaf && left.index == right.index) {
+            int levels = 0;
+            while (levels < left.depth && levels < right.depth
+                   && left.path[left.depth - 1 - levels]
+                          == right.path[right.depth - 1 - levels])
+                ++levels;
+            left.depth -= levels;
+            right.depth -= levels;
+            left.next_leaf();
+            right.next_leaf();
+            continue;
+        }
+
+        int result = compare_texts(*left, *right);
+        if (result != 0)
+            return sign(result);
+        ++left;
+        ++right;
+    }
+    if (left != lhs.end())
+        return 1;
+    return right != rhs.end() ? -1 : 0;
+}
+
+bool jnp1::operator<(const Strset_tree& lhs, const Strset_tree& rhs) {
+    return compare(lhs, rhs) < 0;
+}
+
+bool jnp1::equal(const Strset_tree& lhs, const Strset_tree& rhs) {
+    if (lhs.size() != rhs.size() || lhs.fingerprint() != rhs.fingerprint())
+        return false;
+    return &lhs == &rhs || compare(lhs, rhs) == 0;
+}
+
+Strset_tree jnp1::set_union(const Strset_tree& lhs, const Strset_tree& rhs,
+                            unsigned thread_count) {
+    return combine(lhs, rhs, Set_operation::set_union, thread_count);
+}
+
+Strset_tree jnp1::set_intersection(const Strset_tree& lhs,
+                                   const Strset_tree& rhs,
+                                   unsigned thread_count) {
+    return combine(lhs, rhs, Set_operation::set_intersection, thread_count);
+}
+
+Strset_tree jnp1::set_difference(const Strset_tree& lhs,
+                                 const Strset_tree& rhs,
+                                 unsigned thread_count) {
+    return combine(lhs, rhs, Set_operation::set_difference, thread_count);
+}
+
+bool jnp1::is_subset(const Strset_tree& subset, const Strset_tree& set) {
+    if (subset.size() > set.size())
+        return false;
+
+    auto element = set.begin();
+    for (auto value : subset) {
+        int order = -1;
+        while (element != set.end()
+               && (order = compare_texts(*element, value)) < 0)
+            ++element;
+        if (order != 0)
+            return false;
+        ++element;
+    }
+    return true;
+}
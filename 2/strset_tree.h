@@ -0,0 +1,314 @@
+#ifndef STRSET_TREE_H
+#define STRSET_TREE_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "strset_pool.h"
+
+namespace jnp1 {
+
+struct Strset_tree_nodes;
+
+// Set of strings ordered lexicographically (the same as std::string), kept in
+// a B+tree with wide nodes. Keys of a node lie next to each other in an array.
+// Strings of up to 8 characters fit in the key, and the longer ones are kept
+// in the character buffer of the node, so no element has an allocation of its
+// own. The first 8 characters of the keys are compared as a single number.
+// In the interned trees the longer strings are kept in the String_pool
+// instead, once for all the trees, and the keys have their handles.
+//
+// Nodes are shared between the copies of the tree: copying it takes a
+// constant time, and a change copies only the nodes on the path to the
+// changed leaf which are shared. The shared nodes are never changed, so the
+// copies may be used from different threads, as long as each copy is used
+// as a single tree would be.
+class Strset_tree {
+    struct Node;
+    struct Inner;
+
+    struct Node_deleter {
+        void operator()(Node* node) const;
+    };
+
+    // Pointer to a node, which counts the references kept in the node.
+    class Node_ptr {
+    public:
+        Node_ptr() = default;
+
+        // Takes the new node, which has a single reference.
+        explicit Node_ptr(Node* node_) : node{node_} {}
+
+        Node_ptr(const Node_ptr& other) : node{other.node} {
+            if (node != nullptr)
+                node->references.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        Node_ptr(Node_ptr&& other) noexcept
+            : node{std::exchange(other.node, nullptr)} {}
+
+        Node_ptr& operator=(Node_ptr other) noexcept {
+            std::swap(node, other.node);
+            return *this;
+        }
+
+        ~Node_ptr() {
+            reset();
+        }
+
+        void reset() {
+            if (node != nullptr
+                && node->references.fetch_sub(1, std::memory_order_acq_rel)
+                       == 1)
+                Node_deleter{}(node);
+            node = nullptr;
+        }
+
+        // Returns true if the node belongs also to other trees, so it must
+        // be copied before it is changed.
+        bool shared() const {
+            return node->references.load(std::memory_order_acquire) > 1;
+        }
+
+        Node* get() const {
+            return node;
+        }
+
+        Node& operator*() const {
+            return *node;
+        }
+
+        Node* operator->() const {
+            return node;
+        }
+
+        explicit operator bool() const {
+            return node != nullptr;
+        }
+
+    private:
+        Node* node{nullptr};
+    };
+
+public:
+    class const_iterator;
+
+    // Where the characters of the strings longer than 8 are kept.
+    enum class Storage {
+        // In the nodes, every copy of a string separately.
+        local,
+        // In the String_pool, every distinct string once.
+        interned
+    };
+
+    Strset_tree() = default;
+    explicit Strset_tree(Storage storage_) : key_storage{storage_} {}
+    Strset_tree(const Strset_tree& other);
+    Strset_tree(Strset_tree&& other) noexcept;
+    Strset_tree& operator=(Strset_tree other) noexcept;
+    ~Strset_tree() = default;
+
+    // Builds the tree of the values, which must be strictly increasing, in
+    // linear time. The nodes are filled up.
+    static Strset_tree from_sorted(const std::vector<std::string_view>& values,
+                                   Storage storage = Storage::local);
+
+    Storage storage() const {
+        return key_storage;
+    }
+
+    // Returns true if the value was not in the set.
+    bool insert(std::string_view value);
+
+    // Returns true if the value was in the set.
+    bool erase(std::string_view value);
+
+    bool contains(std::string_view value) const;
+
+    size_t size() const {
+        return element_count;
+    }
+
+    // Hash of the set, which does not depend on the order the elements were
+    // inserted in, kept up to date by every change. Equal sets have equal
+    // fingerprints.
+    uint64_t fingerprint() const {
+        return element_hash_sum;
+    }
+
+    void clear();
+
+    // Grows with every change of the tree which may invalidate its
+    // iterators, so an iterator found at the same version is still valid.
+    uint64_t version() const {
+        return change_count;
+    }
+
+    const_iterator begin() const;
+    const_iterator end() const;
+
+    // Returns the first element not less than the value.
+    const_iterator lower_bound(std::string_view value) const;
+
+    // Returns up to [count] elements (or the smallest keys of the subtrees),
+    // increasing and spread over the set, which split it into nearly equal
+    // parts. The first one is always "".
+    std::vector<std::string_view> split_points(size_t count) const;
+
+private:
+    friend struct Strset_tree_nodes;
+    friend int compare(const Strset_tree& lhs, const Strset_tree& rhs);
+
+    // Number of the keys of a leaf and of the children of an inner node. The
+    // arrays have one more place, for the overfull node before it is split.
+    static constexpr int capacity{64};
+    static constexpr int min_count{capacity / 4};
+    static constexpr uint32_t inline_length{8};
+
+    // Every node but the root has at least min_count children, so the tree
+    // of 2^64 elements is not deeper than this.
+    static constexpr int max_depth{16};
+
+    struct Node {
+        Node(bool leaf_, bool interned_) : leaf{leaf_}, interned{interned_} {}
+
+        std::string_view text(int i) const {
+            if (lengths[i] <= inline_length)
+                return std::string_view(heads[i], lengths[i]);
+            if (interned)
+                return String_pool::text(offsets[i]);
+            return std::string_view(arena.data() + offsets[i], lengths[i]);
+        }
+
+        // Number of the pointers to the node, from the trees and from the
+        // parents.
+        std::atomic<int> references{1};
+        bool leaf;
+        // Whether the long keys are in the String_pool, and their offsets
+        // are the handles there.
+        bool interned;
+        int count{0};
+        // Characters of the long keys, and the number of those which do not
+        // belong to any key anymore.
+        std::string arena;
+        size_t dead_bytes{0};
+        // The keys, in separate arrays, so that the binary search over the
+        // heads touches as few cache lines as possible. The head is the first
+        // characters of the key padded with zeros, and the key longer than
+        // that is in the arena. In an inner node the key i (for i >= 1) is
+        // the smallest key of the subtree children[i], and the key 0 is not
+        // used.
+        char heads[capacity + 1][inline_length];
+        uint32_t lengths[capacity + 1];
+        uint32_t offsets[capacity + 1];
+    };
+
+    struct Inner : Node {
+        explicit Inner(bool interned_) : Node{false, interned_} {}
+
+        Node_ptr children[capacity + 1];
+    };
+
+    struct Probe;
+    struct Split;
+
+    // Copies the node, sharing its children.
+    static Node_ptr copy(const Node& node);
+    static Split insert(Node& node, const Probe& probe);
+    static bool erase(Node& node, const Probe& probe);
+    static void rebalance(Inner& parent, int i);
+
+    Node_ptr root;
+    size_t element_count{0};
+    // The sum of the hashes of the elements.
+    uint64_t element_hash_sum{0};
+    Storage key_storage{Storage::local};
+    uint64_t change_count{0};
+};
+
+// Goes over the strings of the set in the increasing order. It is invalidated
+// by any change of the set.
+class Strset_tree::const_iterator {
+public:
+    using iterator_category = std::forward_iterator_tag;
+    using value_type = std::string_view;
+    using difference_type = std::ptrdiff_t;
+    using pointer = const std::string_view*;
+    using reference = std::string_view;
+
+    const_iterator() = default;
+
+    std::string_view operator*() const {
+        return leaf->text(index);
+    }
+
+    const_iterator& operator++() {
+        if (++index == leaf->count)
+            next_leaf();
+        return *this;
+    }
+
+    const_iterator operator++(int) {
+        auto result = *this;
+        ++*this;
+        return result;
+    }
+
+    bool operator==(const const_iterator& other) const {
+        return leaf == other.leaf && index == other.index;
+    }
+
+    bool operator!=(const const_iterator& other) const {
+        return !(*this == other);
+    }
+
+private:
+    friend class Strset_tree;
+    friend int compare(const Strset_tree& lhs, const Strset_tree& rhs);
+
+    // Goes down to the first leaf of the subtree.
+    void descend(const Node* node);
+    void next_leaf();
+
+    // Inner nodes on the path to the leaf, and the positions of the children
+    // the path goes through.
+    const Inner* path[max_depth]{};
+    int positions[max_depth]{};
+    int depth{0};
+    const Node* leaf{nullptr};
+    int index{0};
+};
+
+// Compares the sets lexicographically, as std::set<std::string> does. Returns
+// -1, 0 or 1. Subtrees shared by the sets are skipped, so a tree and its
+// copy are compared in the time proportional to the changes made to them.
+int compare(const Strset_tree& lhs, const Strset_tree& rhs);
+
+bool operator<(const Strset_tree& lhs, const Strset_tree& rhs);
+
+// Returns true if the sets are equal. Sets of different sizes or
+// fingerprints are told apart without looking at their elements.
+bool equal(const Strset_tree& lhs, const Strset_tree& rhs);
+
+// The set operations, each a single merge pass over both sets. With
+// thread_count > 1 the sets are split into ranges of the keys which are
+// merged in parallel. The result keeps the strings as lhs does.
+Strset_tree set_union(const Strset_tree& lhs, const Strset_tree& rhs,
+                      unsigned thread_count = 1);
+Strset_tree set_intersection(const Strset_tree& lhs, const Strset_tree& rhs,
+                             unsigned thread_count = 1);
+Strset_tree set_difference(const Strset_tree& lhs, const Strset_tree& rhs,
+                           unsigned thread_count = 1);
+
+// Returns true if every element of [subset] is in [set].
+bool is_subset(const Strset_tree& subset, const Strset_tree& set);
+
+}  // namespace jnp1
+
+#endif
@@ -1,4 +1,5 @@
 #include <iostream>
+#include <mutex>
 
 #include "strset.h"
 #include "strsetconst.h"
@@ -11,10 +12,10 @@ const bool debug{true};
 
 namespace {
 
-bool& const_set_already_created() {
-    static bool const_set_already_created{false};
-    return const_set_already_created;
-}
+// Set while this thread creates the 42 Set. strset_insert() calls strset42()
+// to check whether it inserts into the 42 Set, which then must not wait for
+// the creation to finish, and gets the id which is not used by any set.
+thread_local bool creating_const_set{false};
 
 unsigned long& const_set_id() {
     static unsigned long const_set_id{4294967295};
@@ -29,17 +30,22 @@ extern "C" {
 #endif
 
 unsigned long strset42() {
-    if (!const_set_already_created()) {
-        if (debug)
-            std::cerr << "strsetconst init invoked\n";
-
-        const_set_already_created() = true;
-        auto created_const_set_id = strset_new();
-        strset_insert(created_const_set_id, "42");
-        const_set_id() = created_const_set_id;
-
-        if (debug)
-            std::cerr << "strsetconst init finished\n";
+    // The other threads wait until the set is created.
+    static std::once_flag const_set_created;
+    if (!creating_const_set) {
+        std::call_once(const_set_created, [] {
+            if (debug)
+                std::cerr << "strsetconst init invoked\n";
+
+            creating_const_set = true;
+            auto created_const_set_id = strset_new();
+            strset_insert(created_const_set_id, "42");
+            const_set_id() = created_const_set_id;
+            creating_const_set = false;
+
+            if (debug)
+                std::cerr << "strsetconst init finished\n";
+        });
     }
 
     return const_set_id();
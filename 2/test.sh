@@ -9,3 +9,5 @@ diff -s my2a.err strset_test2a.err
 ./strset2b 2> my2b.err
 echo $?
 diff -s my2b.err strset_test2b.err
+./strset3 2> /dev/null
+echo $?